@@ -0,0 +1,940 @@
+/**
+ * ===================================================================
+ *
+ * Author: Nikolaus Mayer, 2018 (mayern@cs.uni-freiburg.de)
+ *
+ * DataInput
+ *
+ * Fast ingestion of numeric plot data
+ *
+ * ===================================================================
+ *
+ * Usage example:
+ *
+ * >
+ * > #include <vector>
+ * > #include <unistd.h>
+ * > #include "DataInput.h"
+ * >
+ * > int main(int argc, char** argv)
+ * > {
+ * >   std::vector<float> data;
+ * >   DataInput::BufferedReader reader(STDIN_FILENO);
+ * >   reader.readAll(data);
+ * >
+ * >   DataInput::MappedFile file("values.txt");
+ * >   DataInput::ParseAll(file.begin(), file.end(), data);
+ * >
+ * >   /// Every 2nd float32 of a record array, without copying
+ * >   DataInput::BinaryLayout layout(0, 2*sizeof(float));
+ * >   std::vector<float> storage;
+ * >   size_t n;
+ * >   const float* values = DataInput::BinaryView<float>(
+ * >                           file.begin(), file.end(), layout, storage, n);
+ * >   return 0;
+ * > }
+ * >
+ *
+ * ===================================================================
+ */
+
+#ifndef DATAINPUT_H__
+#define DATAINPUT_H__
+
+// System/STL
+#include <cerrno>
+#include <cmath>          // std::pow
+#include <cstring>        // std::memmove, std::memcpy
+#include <stdint.h>       // uint16_t, ...
+#include <algorithm>      // std::max, std::swap
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>        // open()
+#include <sys/mman.h>     // mmap(), madvise()
+#include <sys/stat.h>     // fstat()
+#include <unistd.h>       // read(), close()
+
+
+
+namespace DataInput {
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Locale-free number parsing
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Whitespace as understood by "std::cin >>" in the "C" locale
+   */
+  inline bool IsSpace( char c )
+  {
+    return c == ' '  or c == '\n' or c == '\t' or
+           c == '\r' or c == '\v' or c == '\f';
+  }
+
+
+  /**
+   * Parse a decimal floating point number, in the spirit of C++17's
+   * std::from_chars: no locale, no allocation, no exceptions, and no
+   * reading beyond "last".
+   *
+   * Accepted: [+-] digits [. digits] [(e|E) [+-] digits]
+   *
+   * The mantissa is accumulated in a 64-bit integer and scaled by an
+   * exact power of ten where possible, which is accurate far beyond
+   * "float" precision.
+   *
+   * @param first Start of the character range
+   * @param last One past the end of the character range
+   * @param value Output; only written on success
+   *
+   * @returns A pointer to the first character not consumed, or "first"
+   *          if no number could be parsed
+   */
+  template <typename T>
+  const char* ParseNumber( const char* first,
+                           const char* last,
+                           T& value )
+  {
+    static const double POW10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                    1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* p = first;
+    bool negative = false;
+    if ( p != last and (*p == '-' or *p == '+') ) {
+      negative = (*p == '-');
+      ++p;
+    }
+
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    size_t digits = 0;
+    /// Integer part; digits beyond what 64 bits can hold only shift
+    /// the decimal exponent
+    while ( p != last and *p >= '0' and *p <= '9' ) {
+      if ( mantissa < 1000000000000000000ULL )
+        mantissa = mantissa*10 + (*p-'0');
+      else
+        ++exponent;
+      ++digits;
+      ++p;
+    }
+    /// Fractional part
+    if ( p != last and *p == '.' ) {
+      ++p;
+      while ( p != last and *p >= '0' and *p <= '9' ) {
+        if ( mantissa < 1000000000000000000ULL ) {
+          mantissa = mantissa*10 + (*p-'0');
+          --exponent;
+        }
+        ++digits;
+        ++p;
+      }
+    }
+    if ( digits == 0 )
+      return first;
+
+    /// Exponent; a dangling "e" is not part of the number
+    if ( p != last and (*p == 'e' or *p == 'E') ) {
+      const char* q = p+1;
+      bool negative_exponent = false;
+      if ( q != last and (*q == '-' or *q == '+') ) {
+        negative_exponent = (*q == '-');
+        ++q;
+      }
+      if ( q != last and *q >= '0' and *q <= '9' ) {
+        int e = 0;
+        while ( q != last and *q >= '0' and *q <= '9' ) {
+          if ( e < 100000 )
+            e = e*10 + (*q-'0');
+          ++q;
+        }
+        exponent += negative_exponent ? -e : e;
+        p = q;
+      }
+    }
+
+    double result = (double)mantissa;
+    if ( mantissa != 0 ) {
+      if ( exponent >= 0 and exponent <= 22 )
+        result *= POW10[exponent];
+      else if ( exponent < 0 and exponent >= -22 )
+        result /= POW10[-exponent];
+      else
+        result *= std::pow(10., exponent);
+    }
+    value = (T)(negative ? -result : result);
+    return p;
+  }
+
+
+  /**
+   * Parse all whitespace-separated numbers in a character range
+   *
+   * @param first Start of the character range
+   * @param last One past the end of the character range
+   * @param out Output container (must support push_back)
+   * @param stop_at_invalid Iff TRUE (default), stop at the first token
+   *        that is not a number; else skip such tokens
+   * @param limit Stop after this many values
+   *
+   * @returns The number of values appended
+   */
+  template <typename Container>
+  size_t ParseAll( const char* first,
+                   const char* last,
+                   Container& out,
+                   bool stop_at_invalid=true,
+                   size_t limit=std::numeric_limits<size_t>::max() )
+  {
+    size_t count = 0;
+    typename Container::value_type value;
+    const char* p = first;
+    while ( count < limit ) {
+      while ( p != last and IsSpace(*p) )
+        ++p;
+      if ( p == last )
+        break;
+      const char* after = ParseNumber(p, last, value);
+      if ( after == p ) {
+        if ( stop_at_invalid )
+          break;
+        while ( p != last and not IsSpace(*p) )
+          ++p;
+        continue;
+      }
+      out.push_back(value);
+      ++count;
+      p = after;
+    }
+    return count;
+  }
+
+
+
+  /**
+   * Skip whitespace-separated tokens without parsing them
+   *
+   * @param first Start of the character range
+   * @param last One past the end of the character range
+   * @param count Number of tokens to skip; updated to the number of
+   *        tokens actually skipped
+   *
+   * @returns A pointer behind the last skipped token
+   */
+  inline const char* SkipTokens( const char* first,
+                                 const char* last,
+                                 size_t& count )
+  {
+    const char* p = first;
+    size_t skipped = 0;
+    while ( skipped < count ) {
+      while ( p != last and IsSpace(*p) )
+        ++p;
+      if ( p == last )
+        break;
+      while ( p != last and not IsSpace(*p) )
+        ++p;
+      ++skipped;
+    }
+    count = skipped;
+    return p;
+  }
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Tabular input
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Field separators of a table row (a row ends at a newline)
+   */
+  inline bool IsFieldSeparator( char c )
+  {
+    return c == ' '  or c == ',' or c == '\t' or
+           c == '\r' or c == '\v' or c == '\f';
+  }
+
+
+  /**
+   * A table of numbers, stored column by column (struct-of-arrays) so
+   * that every column is one contiguous array that can be plotted
+   * directly
+   */
+  template <typename T>
+  class ColumnTable {
+    public:
+      /// Constructor
+      ColumnTable() {};
+      /// Destructor
+      ~ColumnTable() {};
+
+      /// Number of columns
+      size_t width() const { return columns.size(); };
+      /// Number of rows (all columns have the same length)
+      size_t rows() const { return columns.empty() ? 0 : columns[0].size(); };
+
+      /// Column titles from the header row; empty if there was none
+      std::vector<std::string> titles;
+      /// The values, one vector per column
+      std::vector<std::vector<T> > columns;
+  };
+
+
+  /**
+   * Parse a table of numbers in a single pass
+   *
+   * Fields are separated by whitespace and/or commas, rows by
+   * newlines. If the first non-empty row contains a field that is not
+   * a number, it is taken as the header with the column titles. The
+   * header, or else the first row, determines the number of columns;
+   * surplus fields of later rows are ignored and missing ones repeat
+   * the value above (0 in the first row).
+   *
+   * @param first Start of the character range
+   * @param last One past the end of the character range
+   * @param table Output; existing contents are replaced
+   * @param stop_at_invalid Iff TRUE (default), stop at the first row
+   *        with a field that is not a number; else treat such fields
+   *        like missing ones
+   *
+   * @returns The number of rows
+   */
+  template <typename T>
+  size_t ParseTable( const char* first,
+                     const char* last,
+                     ColumnTable<T>& table,
+                     bool stop_at_invalid=true )
+  {
+    table.titles.clear();
+    table.columns.clear();
+    const char* p = first;
+    /// Boundaries of the fields of the current row
+    std::vector<const char*> fields;
+    size_t rows = 0;
+
+    while ( p != last ) {
+      /// Split the next row into fields
+      fields.clear();
+      while ( p != last and *p != '\n' ) {
+        while ( p != last and IsFieldSeparator(*p) )
+          ++p;
+        if ( p == last or *p == '\n' )
+          break;
+        fields.push_back(p);
+        while ( p != last and *p != '\n' and not IsFieldSeparator(*p) )
+          ++p;
+        fields.push_back(p);
+      }
+      if ( p != last )
+        ++p;
+      const size_t n_fields = fields.size()/2;
+      if ( n_fields == 0 )
+        continue;
+
+      /// The first row decides the table width, and may be a header
+      if ( table.columns.empty() ) {
+        bool header = false;
+        for ( size_t f = 0; f < n_fields and not header; ++f ) {
+          T value;
+          header = (ParseNumber(fields[2*f], fields[2*f+1], value)
+                    != fields[2*f+1]);
+        }
+        table.columns.resize(n_fields);
+        if ( header ) {
+          for ( size_t f = 0; f < n_fields; ++f )
+            table.titles.push_back(std::string(fields[2*f],
+                                               fields[2*f+1]));
+          continue;
+        }
+      }
+
+      /// Parse the whole row before appending, so that a row with an
+      /// invalid field can be dropped completely
+      const size_t width = table.columns.size();
+      bool valid = true;
+      for ( size_t c = 0; c < width and valid; ++c ) {
+        std::vector<T>& column = table.columns[c];
+        T value = rows > 0 ? column[rows-1] : T(0);
+        /// Like the header check: the number must be the whole field
+        if ( c < n_fields and
+             ParseNumber(fields[2*c], fields[2*c+1], value) != fields[2*c+1] ) {
+          value = rows > 0 ? column[rows-1] : T(0);
+          valid = not stop_at_invalid;
+        }
+        column.push_back(value);
+      }
+      if ( not valid ) {
+        for ( size_t c = 0; c < width and table.columns[c].size() > rows; ++c )
+          table.columns[c].pop_back();
+        break;
+      }
+      ++rows;
+    }
+    return rows;
+  }
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Buffered reading from file descriptors
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Read whitespace-separated numbers from a file descriptor
+   *
+   * Input is pulled in large blocks via read(2) into a buffer that is
+   * reused for the whole lifetime of the reader. A number that
+   * straddles two blocks is moved to the front of the buffer before
+   * the next block is appended, so the parser always sees complete
+   * tokens.
+   *
+   * @param fd The file descriptor to read from (not closed)
+   * @param stop_at_invalid Iff TRUE (default), stop at the first token
+   *        that is not a number, like "std::cin >> value" does; else
+   *        skip such tokens
+   * @param block_size Number of bytes requested per read(2) call
+   */
+  class BufferedReader {
+    public:
+      /// Constructor
+      BufferedReader( int fd,
+                      bool stop_at_invalid=true,
+                      size_t block_size=1<<16
+                    )
+        : m_fd(fd),
+          m_stop_at_invalid(stop_at_invalid),
+          m_block_size(block_size),
+          m_buffer(block_size),
+          m_begin(0),
+          m_end(0),
+          m_eof(false),
+          m_done(false)
+      {};
+      /// Destructor
+      ~BufferedReader() {};
+
+      /**
+       * Fetch the next number
+       *
+       * @param value Output
+       *
+       * @returns FALSE iff the input is exhausted (or, if enabled,
+       *          a non-number was encountered)
+       */
+      template <typename T>
+      bool next( T& value )
+      {
+        while ( not m_done ) {
+          /// Skip whitespace
+          while ( m_begin < m_end and IsSpace(m_buffer[m_begin]) )
+            ++m_begin;
+          if ( m_begin == m_end ) {
+            if ( not _fill() )
+              m_done = true;
+            continue;
+          }
+
+          /// Make sure the whole token is in the buffer
+          size_t token_end = m_begin;
+          while ( true ) {
+            while ( token_end < m_end and not IsSpace(m_buffer[token_end]) )
+              ++token_end;
+            if ( token_end < m_end or m_eof )
+              break;
+            const size_t consumed = token_end-m_begin;
+            _fill();
+            token_end = m_begin+consumed;
+          }
+
+          const char* token = &m_buffer[0]+m_begin;
+          const char* after = ParseNumber(token,
+                                          &m_buffer[0]+token_end,
+                                          value);
+          if ( after == token ) {
+            if ( m_stop_at_invalid ) {
+              m_done = true;
+              return false;
+            }
+            m_begin = token_end;
+            continue;
+          }
+          /// Like "std::cin >>", continue right after the number even
+          /// if the token has trailing garbage
+          m_begin += after-token;
+          return true;
+        }
+        return false;
+      }
+
+      /**
+       * Skip tokens without parsing them
+       *
+       * @param count Number of tokens to skip
+       *
+       * @returns The number of tokens skipped (less than "count" only
+       *          at the end of the input)
+       */
+      size_t skip( size_t count )
+      {
+        size_t skipped = 0;
+        /// A token can continue in the next block, so it only counts
+        /// once the whitespace (or the input end) behind it is seen
+        bool in_token = false;
+        while ( skipped < count and not m_done ) {
+          if ( m_begin == m_end ) {
+            if ( not _fill() ) {
+              m_done = true;
+              if ( in_token )
+                ++skipped;
+            }
+            continue;
+          }
+          if ( IsSpace(m_buffer[m_begin]) ) {
+            if ( in_token )
+              ++skipped;
+            in_token = false;
+          } else {
+            in_token = true;
+          }
+          ++m_begin;
+        }
+        return skipped;
+      }
+
+      /**
+       * Append all remaining numbers to a container
+       *
+       * @param out Output container (must support push_back)
+       * @param limit Stop after this many values
+       *
+       * @returns The number of values appended
+       */
+      template <typename Container>
+      size_t readAll( Container& out,
+                      size_t limit=std::numeric_limits<size_t>::max() )
+      {
+        size_t count = 0;
+        typename Container::value_type value;
+        while ( count < limit and next(value) ) {
+          out.push_back(value);
+          ++count;
+        }
+        return count;
+      }
+
+    private:
+      /**
+       * Discard consumed bytes and append one block of fresh input
+       *
+       * @returns FALSE iff no more input is available
+       */
+      bool _fill()
+      {
+        if ( m_eof )
+          return false;
+
+        /// Keep the unconsumed tail (a partial token) at the front
+        if ( m_begin > 0 ) {
+          std::memmove(&m_buffer[0], &m_buffer[0]+m_begin, m_end-m_begin);
+          m_end -= m_begin;
+          m_begin = 0;
+        }
+        /// A single token longer than the whole buffer
+        if ( m_buffer.size()-m_end < m_block_size )
+          m_buffer.resize(m_end+m_block_size);
+
+        while ( true ) {
+          const ssize_t n = ::read(m_fd, &m_buffer[0]+m_end, m_block_size);
+          if ( n < 0 ) {
+            if ( errno == EINTR )
+              continue;
+            throw std::runtime_error(std::string("read() failed: ")
+                                     + std::strerror(errno));
+          }
+          if ( n == 0 ) {
+            m_eof = true;
+            return false;
+          }
+          m_end += (size_t)n;
+          return true;
+        }
+      }
+
+      const int m_fd;
+      const bool m_stop_at_invalid;
+      const size_t m_block_size;
+      std::vector<char> m_buffer;
+      /// Unconsumed bytes are m_buffer[m_begin, m_end)
+      size_t m_begin;
+      size_t m_end;
+      bool m_eof;
+      bool m_done;
+  };
+
+
+
+
+  /**
+   * Read everything from a file descriptor into a byte buffer
+   *
+   * @param fd The file descriptor to read from (not closed)
+   * @param out Output buffer; the input is appended
+   * @param block_size Number of bytes requested per read(2) call
+   *
+   * @returns The number of bytes appended
+   */
+  inline size_t ReadAll( int fd,
+                         std::vector<char>& out,
+                         size_t block_size=1<<20 )
+  {
+    const size_t start = out.size();
+    size_t end = start;
+    while ( true ) {
+      if ( out.size()-end < block_size )
+        out.resize(std::max(end+block_size, 2*out.size()));
+      const ssize_t n = ::read(fd, &out[0]+end, block_size);
+      if ( n < 0 ) {
+        if ( errno == EINTR )
+          continue;
+        throw std::runtime_error(std::string("read() failed: ")
+                                 + std::strerror(errno));
+      }
+      if ( n == 0 )
+        break;
+      end += (size_t)n;
+    }
+    out.resize(end);
+    return end-start;
+  }
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Files
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Read-only file descriptor that is closed on destruction, for input
+   * that is read rather than mapped (e.g. a file that keeps growing)
+   *
+   * @param path The file to open
+   */
+  class OpenFile {
+    public:
+      /// Constructor
+      OpenFile( const std::string& path )
+        : m_fd(::open(path.c_str(), O_RDONLY))
+      {
+        if ( m_fd < 0 )
+          throw std::runtime_error("Cannot open \"" + path + "\": "
+                                   + std::strerror(errno));
+      };
+      /// Destructor
+      ~OpenFile() { ::close(m_fd); };
+
+      int fd() const { return m_fd; };
+
+    private:
+      /// Not copyable
+      OpenFile( const OpenFile& );
+      OpenFile& operator=( const OpenFile& );
+
+      int m_fd;
+  };
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Memory-mapped files
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Read-only memory mapping of a whole file
+   *
+   * The mapping is advised for sequential access so that the kernel
+   * reads ahead aggressively and drops pages behind the parser. If the
+   * path is not a regular file (e.g. a FIFO), nothing is mapped and
+   * the still open descriptor can be handed to a BufferedReader.
+   *
+   * @param path The file to map
+   */
+  class MappedFile {
+    public:
+      /// Constructor
+      MappedFile( const std::string& path )
+        : m_fd(-1),
+          m_data(0),
+          m_size(0),
+          m_regular(false),
+          m_mapped(false)
+      {
+        m_fd = ::open(path.c_str(), O_RDONLY);
+        if ( m_fd < 0 )
+          throw std::runtime_error("Cannot open \"" + path + "\": "
+                                   + std::strerror(errno));
+        struct stat st;
+        if ( ::fstat(m_fd, &st) != 0 ) {
+          ::close(m_fd);
+          throw std::runtime_error("Cannot stat \"" + path + "\": "
+                                   + std::strerror(errno));
+        }
+        m_regular = S_ISREG(st.st_mode);
+        if ( not m_regular or st.st_size == 0 )
+          return;
+
+        m_size = (size_t)st.st_size;
+        void* addr = ::mmap(0, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if ( addr == MAP_FAILED ) {
+          ::close(m_fd);
+          throw std::runtime_error("Cannot mmap \"" + path + "\": "
+                                   + std::strerror(errno));
+        }
+        ::madvise(addr, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(addr);
+        m_mapped = true;
+      };
+      /// Destructor
+      ~MappedFile()
+      {
+        if ( m_mapped )
+          ::munmap(const_cast<char*>(m_data), m_size);
+        if ( m_fd >= 0 )
+          ::close(m_fd);
+      };
+
+      /// TRUE iff the file is a regular file (empty files count)
+      bool regular() const { return m_regular; };
+      /// Underlying file descriptor, e.g. for non-regular files
+      int fd() const { return m_fd; };
+      const char* begin() const { return m_data; };
+      const char* end() const { return m_data+m_size; };
+      size_t size() const { return m_size; };
+
+    private:
+      /// Not copyable
+      MappedFile( const MappedFile& );
+      MappedFile& operator=( const MappedFile& );
+
+      int m_fd;
+      const char* m_data;
+      size_t m_size;
+      bool m_regular;
+      bool m_mapped;
+  };
+
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Raw binary input
+  /// /////////////////////////////////////////////////////////////////
+
+  /// Supported binary element types
+  enum BinaryFormat
+  {
+    F32,
+    F64,
+    I32,
+    I64,
+    U16
+  };
+
+
+  /**
+   * Parse a binary format name ("f32", "f64", "i32", "i64", "u16")
+   *
+   * @param name The format name
+   * @param format Output; only written on success
+   *
+   * @returns FALSE iff "name" is not a known format
+   */
+  inline bool ParseBinaryFormat( const std::string& name,
+                                 BinaryFormat& format )
+  {
+    if      ( name == "f32" ) format = F32;
+    else if ( name == "f64" ) format = F64;
+    else if ( name == "i32" ) format = I32;
+    else if ( name == "i64" ) format = I64;
+    else if ( name == "u16" ) format = U16;
+    else return false;
+    return true;
+  }
+
+
+  /**
+   * Parse a byte order name ("little", "big")
+   *
+   * @param name The byte order name
+   * @param big_endian Output; only written on success
+   *
+   * @returns FALSE iff "name" is not a known byte order
+   */
+  inline bool ParseByteOrder( const std::string& name,
+                              bool& big_endian )
+  {
+    if      ( name == "little" ) big_endian = false;
+    else if ( name == "big"    ) big_endian = true;
+    else return false;
+    return true;
+  }
+
+
+  /// TRUE iff this machine stores numbers little-endian
+  inline bool HostIsLittleEndian()
+  {
+    #if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+      return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+    #else
+      const uint16_t probe = 1;
+      return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+    #endif
+  }
+
+
+  /**
+   * Where to find the values inside a binary buffer
+   *
+   * @param offset Byte offset of the first value
+   * @param stride Byte distance between consecutive values; 0 means
+   *        densely packed (= sizeof of the element type)
+   * @param big_endian Iff TRUE, values are stored big-endian
+   */
+  class BinaryLayout {
+    public:
+      /// Constructor
+      BinaryLayout( size_t offset=0,
+                    size_t stride=0,
+                    bool big_endian=false
+                  )
+        : offset(offset),
+          stride(stride),
+          big_endian(big_endian)
+      {};
+
+      /// Configuration parameters
+      size_t offset;
+      size_t stride;
+      bool big_endian;
+  };
+
+
+  /**
+   * Interpret a byte range as an array of T
+   *
+   * If the values are densely packed, suitably aligned and stored in
+   * the host's byte order, the returned pointer points directly into
+   * the input range and nothing is copied. Otherwise the values are
+   * gathered (and byte-swapped) into "storage".
+   *
+   * @param first Start of the byte range
+   * @param last One past the end of the byte range
+   * @param layout Offset, stride and byte order of the values
+   * @param storage Scratch space for the non-zero-copy case
+   * @param n Output: the number of values
+   *
+   * @returns A pointer to "n" values of type T
+   */
+  template <typename T>
+  const T* BinaryView( const char* first,
+                       const char* last,
+                       const BinaryLayout& layout,
+                       std::vector<T>& storage,
+                       size_t& n )
+  {
+    const size_t size   = (size_t)(last-first);
+    const size_t stride = (layout.stride == 0) ? sizeof(T) : layout.stride;
+    n = 0;
+    if ( layout.offset >= size or size-layout.offset < sizeof(T) )
+      return 0;
+    n = (size-layout.offset-sizeof(T))/stride + 1;
+
+    const char* base = first+layout.offset;
+    const bool swap  = (layout.big_endian == HostIsLittleEndian());
+    if ( not swap and stride == sizeof(T) and
+         reinterpret_cast<uintptr_t>(base) % alignof(T) == 0 )
+      return reinterpret_cast<const T*>(base);
+
+    storage.resize(n);
+    for ( size_t i = 0; i < n; ++i ) {
+      char bytes[sizeof(T)];
+      std::memcpy(bytes, base+i*stride, sizeof(T));
+      if ( swap )
+        for ( size_t b = 0; b < sizeof(T)/2; ++b )
+          std::swap(bytes[b], bytes[sizeof(T)-1-b]);
+      std::memcpy(&storage[i], bytes, sizeof(T));
+    }
+    return &storage[0];
+  }
+
+
+  /**
+   * Random access to the values of a binary buffer, without copying
+   * the buffer (see BinaryView() for a whole-array view)
+   *
+   * @param first Start of the byte range
+   * @param last One past the end of the byte range
+   * @param layout Offset, stride and byte order of the values
+   */
+  template <typename T>
+  class BinaryValues {
+    public:
+      /// Constructor
+      BinaryValues( const char* first,
+                    const char* last,
+                    const BinaryLayout& layout
+                  )
+        : m_base(first+layout.offset),
+          m_stride(layout.stride == 0 ? sizeof(T) : layout.stride),
+          m_size(0),
+          m_swap(layout.big_endian == HostIsLittleEndian())
+      {
+        const size_t size = (size_t)(last-first);
+        if ( layout.offset < size and size-layout.offset >= sizeof(T) )
+          m_size = (size-layout.offset-sizeof(T))/m_stride + 1;
+      };
+      /// Destructor
+      ~BinaryValues() {};
+
+      /// Number of values
+      size_t size() const { return m_size; };
+
+      /// The i-th value
+      T operator[]( size_t i ) const
+      {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, m_base+i*m_stride, sizeof(T));
+        if ( m_swap )
+          for ( size_t b = 0; b < sizeof(T)/2; ++b )
+            std::swap(bytes[b], bytes[sizeof(T)-1-b]);
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+      }
+
+      /// The values as an array if they can be used in place (densely
+      /// packed, aligned, host byte order), else 0
+      const T* contiguous() const
+      {
+        if ( m_swap or m_stride != sizeof(T) or
+             reinterpret_cast<uintptr_t>(m_base) % alignof(T) != 0 )
+          return 0;
+        return reinterpret_cast<const T*>(m_base);
+      }
+
+    private:
+      const char* m_base;
+      size_t m_stride;
+      size_t m_size;
+      bool m_swap;
+  };
+
+
+}  // namespace DataInput
+
+
+
+#endif  // DATAINPUT_H__
+
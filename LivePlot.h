@@ -0,0 +1,745 @@
+/**
+ * ===================================================================
+ *
+ * Author: Nikolaus Mayer, 2018 (mayern@cs.uni-freiburg.de)
+ *
+ * LivePlot
+ *
+ * Redraw a sparkline in place while new data keeps arriving
+ *
+ * ===================================================================
+ *
+ * Usage example:
+ *
+ * >
+ * > #include <iostream>
+ * > #include <unistd.h>
+ * > #include "LivePlot.h"
+ * >
+ * > int main(int argc, char** argv)
+ * > {
+ * >   Sparkline::Configuration<float> config;
+ * >   config.setHeight(5);
+ * >   config.setBox(true);
+ * >
+ * >   /// Show the last 80 values from STDIN, redraw at most 10x per second
+ * >   LivePlot::Follow(STDIN_FILENO, config, 80, 10.f, std::cout);
+ * >   return 0;
+ * > }
+ * >
+ *
+ * ===================================================================
+ */
+
+#ifndef LIVEPLOT_H__
+#define LIVEPLOT_H__
+
+// System/STL
+#include <algorithm>      // std::min
+#include <atomic>
+#include <chrono>
+#include <cstdio>         // snprintf
+#include <cstring>        // std::memcmp, std::memcpy, std::memset
+#include <exception>      // std::exception_ptr
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>       // uint16_t
+// Local files
+#include "DataInput.h"
+#include "Sparkline.h"
+
+
+
+namespace LivePlot {
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Containers
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Lock-free single-producer/single-consumer queue
+   *
+   * Exactly one thread may call push(), and exactly one (other) thread
+   * may call pop(). Neither call ever blocks.
+   *
+   * @param capacity_log2 The queue holds up to 2^capacity_log2 - 1
+   *        elements
+   */
+  template <typename T>
+  class SpscQueue {
+    public:
+      /// Constructor
+      SpscQueue( size_t capacity_log2=16 )
+        : m_mask(((size_t)1 << capacity_log2)-1),
+          m_buffer(m_mask+1),
+          m_head(0),
+          m_tail(0)
+      {};
+      /// Destructor
+      ~SpscQueue() {};
+
+      /**
+       * Producer side: append an element
+       *
+       * @returns FALSE iff the queue is full
+       */
+      bool push( const T& value )
+      {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t next = (tail+1) & m_mask;
+        if ( next == m_head.load(std::memory_order_acquire) )
+          return false;
+        m_buffer[tail] = value;
+        m_tail.store(next, std::memory_order_release);
+        return true;
+      }
+
+      /**
+       * Consumer side: remove the oldest element
+       *
+       * @returns FALSE iff the queue is empty
+       */
+      bool pop( T& value )
+      {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if ( head == m_tail.load(std::memory_order_acquire) )
+          return false;
+        value = m_buffer[head];
+        m_head.store((head+1) & m_mask, std::memory_order_release);
+        return true;
+      }
+
+    private:
+      /// Not copyable
+      SpscQueue( const SpscQueue& );
+      SpscQueue& operator=( const SpscQueue& );
+
+      const size_t m_mask;
+      std::vector<T> m_buffer;
+      /// Producer and consumer indices live on separate cache lines
+      alignas(64) std::atomic<size_t> m_head;
+      alignas(64) std::atomic<size_t> m_tail;
+  };
+
+
+  /**
+   * Fixed-capacity buffer that keeps the most recent values
+   *
+   * @param capacity The number of values to keep
+   */
+  template <typename T>
+  class RingBuffer {
+    public:
+      /// Constructor
+      RingBuffer( size_t capacity )
+        : m_buffer(std::max(capacity, (size_t)1)),
+          m_next(0),
+          m_size(0)
+      {};
+      /// Destructor
+      ~RingBuffer() {};
+
+      /// Add a value, overwriting the oldest one if full
+      void push( const T& value )
+      {
+        m_buffer[m_next] = value;
+        m_next = (m_next+1) % m_buffer.size();
+        if ( m_size < m_buffer.size() )
+          ++m_size;
+      }
+
+      /// Copy the contents, oldest first, into "out"
+      void linearize( std::vector<T>& out ) const
+      {
+        out.resize(m_size);
+        const size_t first = (m_next+m_buffer.size()-m_size) % m_buffer.size();
+        for ( size_t i = 0; i < m_size; ++i )
+          out[i] = m_buffer[(first+i) % m_buffer.size()];
+      }
+
+      size_t size() const { return m_size; };
+      size_t capacity() const { return m_buffer.size(); };
+
+    private:
+      std::vector<T> m_buffer;
+      size_t m_next;
+      size_t m_size;
+  };
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Terminal output
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Overwrite the previously drawn frame with a new one
+   *
+   * The cursor is moved back to the start of the old frame, which is
+   * then cleared from there to the end of the screen.
+   *
+   * @param os Output stream (a terminal)
+   * @param frame The new frame
+   * @param previous_lines Number of line breaks in the previous
+   *        frame; updated to the count of the new frame
+   */
+  inline void Redraw( std::ostream& os,
+                      const std::string& frame,
+                      size_t& previous_lines )
+  {
+    if ( previous_lines > 0 )
+      os << "\r\x1b[" << previous_lines << "A\x1b[J";
+    else
+      os << "\r\x1b[J";
+    os << frame << std::flush;
+    previous_lines = (size_t)std::count(frame.begin(), frame.end(), '\n');
+  }
+
+
+
+  /**
+   * A frame as a grid of character cells, for FrameDiff
+   *
+   * This is a sink for SparklineTo() etc. that keeps plot elements
+   * instead of bytes: its writer (FrameCellWriter, see
+   * Sparkline::WriterFor) stores every character with its style, so
+   * frames can be compared without looking at escape sequences. The
+   * cells are kept across frames, so redrawing stops allocating.
+   */
+  class FrameCells {
+    public:
+      /// One character cell: a UTF-8 encoded glyph (zero-padded) and
+      /// its SparklineWriter style; blanks are always Plain
+      struct Cell {
+        char bytes[4];
+        uint16_t style;
+        bool operator==( const Cell& o ) const
+        {
+          return style == o.style and
+                 std::memcmp(bytes, o.bytes, sizeof(bytes)) == 0;
+        };
+        bool operator!=( const Cell& o ) const { return not (*this == o); };
+        /// Number of bytes of the glyph
+        size_t length() const
+        {
+          size_t n = 1;
+          while ( n < sizeof(bytes) and bytes[n] != 0 )
+            ++n;
+          return n;
+        }
+      };
+
+      /// Constructor
+      FrameCells()
+        : m_colored(false),
+          m_gradient(Sparkline::Solid)
+      {
+        clear();
+      };
+      /// Destructor
+      ~FrameCells() {};
+
+      /// Forget the previous contents (but keep the memory)
+      void clear()
+      {
+        m_cells.clear();
+        m_line_starts.assign(1, 0);
+      }
+
+      /// Number of lines (a trailing line break starts an empty line)
+      size_t lines() const { return m_line_starts.size(); };
+      /// Number of cells of a line
+      size_t width( size_t line ) const
+      {
+        return (line+1 < m_line_starts.size() ? m_line_starts[line+1]
+                                               : m_cells.size())
+               - m_line_starts[line];
+      }
+      /// Cells of a line
+      const Cell* line( size_t line ) const
+      {
+        return m_cells.data() + m_line_starts[line];
+      }
+
+      /// Colors of the frame (from its configuration)
+      bool colored() const { return m_colored; };
+      Sparkline::Gradient gradient() const { return m_gradient; };
+
+      /// Writer interface, see FrameCellWriter
+      void setColors( bool colored,
+                      Sparkline::Gradient gradient )
+      {
+        m_colored  = colored;
+        m_gradient = gradient;
+      }
+      void put( const char* bytes,
+                size_t length,
+                unsigned int style )
+      {
+        Cell cell;
+        std::memset(cell.bytes, 0, sizeof(cell.bytes));
+        std::memcpy(cell.bytes, bytes, std::min(length, sizeof(cell.bytes)));
+        cell.style = (length == 1 and bytes[0] == ' ') ? 0 : (uint16_t)style;
+        m_cells.push_back(cell);
+      }
+      void newline() { m_line_starts.push_back(m_cells.size()); }
+
+      void swap( FrameCells& other )
+      {
+        m_cells.swap(other.m_cells);
+        m_line_starts.swap(other.m_line_starts);
+        std::swap(m_colored, other.m_colored);
+        std::swap(m_gradient, other.m_gradient);
+      }
+
+    private:
+      std::vector<Cell> m_cells;
+      std::vector<size_t> m_line_starts;
+      bool m_colored;
+      Sparkline::Gradient m_gradient;
+  };
+
+
+  /**
+   * Writer for FrameCells; it has the interface of SparklineWriter and
+   * lays elements out exactly as SparklineWriter does (number padding,
+   * bar colors), but stores cells instead of bytes
+   */
+  class FrameCellWriter {
+    public:
+      /// The writer whose layout is reproduced
+      typedef Sparkline::SparklineWriter<Sparkline::CountingSink> Layout;
+
+      /// Element styles, see SparklineWriter
+      enum Style
+      {
+        Plain = Layout::Plain,
+        Box   = Layout::Box,
+        Bars  = Layout::Bars,
+        Shade = Layout::Shade
+      };
+
+      /// Constructor
+      FrameCellWriter( FrameCells& cells,
+                       bool print_colored )
+        : m_cells(cells),
+          m_layout(m_counter, print_colored),
+          m_colored(print_colored)
+      {
+        m_cells.setColors(print_colored, Sparkline::Solid);
+      };
+
+      void setGradient( Sparkline::Gradient gradient,
+                        unsigned int levels )
+      {
+        m_layout.setGradient(gradient, levels);
+        m_cells.setColors(m_colored, gradient);
+      }
+
+      void raw( const char* data, size_t n ) { _text(Plain, data, n); }
+      void raw( const std::string& s ) { raw(s.data(), s.size()); }
+      void raw( char c ) { raw(&c, 1); }
+
+      void spaces( size_t n )
+      {
+        for ( size_t i = 0; i < n; ++i )
+          m_cells.put(" ", 1, Plain);
+      }
+
+      void blankField( size_t width )
+      {
+        const int n = (int)width;
+        spaces(n > 1 ? n : 1);
+      }
+
+      void styled( unsigned int style, const char* data, size_t n )
+      {
+        _text(style, data, n);
+      }
+      void styled( unsigned int style, const std::string& s )
+      {
+        styled(style, s.data(), s.size());
+      }
+
+      template <typename U>
+      void number( unsigned int style, U value, size_t width=0 )
+      {
+        char buffer[64];
+        const size_t n = Layout::Format(buffer, sizeof(buffer), value);
+        _text(style, buffer, n);
+        spaces(m_layout.padding(style, n, width));
+      }
+
+      void cell( unsigned int code,
+                 unsigned int height=0 )
+      {
+        const Layout::Glyph& glyph = Layout::CellGlyph(code);
+        m_cells.put(glyph.bytes, glyph.length, m_layout.barStyle(height));
+      }
+
+      void braille( unsigned int mask,
+                    unsigned int height=0 )
+      {
+        const Layout::Glyph& glyph = Layout::BrailleGlyph(mask);
+        m_cells.put(glyph.bytes, glyph.length, m_layout.barStyle(height));
+      }
+
+      void endCells() {}
+      void close() {}
+
+    private:
+      /// One cell per UTF-8 encoded character
+      void _text( unsigned int style, const char* data, size_t n )
+      {
+        size_t i = 0;
+        while ( i < n ) {
+          const unsigned char c = data[i];
+          if ( c == '\n' ) {
+            m_cells.newline();
+            ++i;
+            continue;
+          }
+          size_t len = 1;
+          if      ( c >= 0xf0 ) len = 4;
+          else if ( c >= 0xe0 ) len = 3;
+          else if ( c >= 0xc0 ) len = 2;
+          len = std::min(len, n-i);
+          m_cells.put(data+i, len, style);
+          i += len;
+        }
+      }
+
+      FrameCells& m_cells;
+      Sparkline::CountingSink m_counter;
+      Layout m_layout;
+      const bool m_colored;
+  };
+
+
+}  // namespace LivePlot
+
+
+namespace Sparkline {
+  /// FrameCells keep cells, not bytes
+  template <>
+  struct WriterFor<LivePlot::FrameCells>
+  {
+    typedef LivePlot::FrameCellWriter type;
+  };
+}  // namespace Sparkline
+
+
+namespace LivePlot {
+
+
+  /**
+   * Incremental frame renderer: only cells that differ from the
+   * previous frame are sent to the terminal
+   *
+   * Every frame is rendered into FrameCells, i.e. straight from the
+   * plot's quantized levels, labels and borders into a grid of glyphs
+   * and styles, and compared with the previous frame cell by cell.
+   * Changed cells are reached with relative cursor movement and drawn
+   * with a SparklineWriter. If the number of lines changes, the frame
+   * is redrawn completely.
+   */
+  class FrameDiff {
+    public:
+      /// Constructor
+      FrameDiff()
+        : m_drawn(false),
+          m_previous_lines(0),
+          m_bytes_written(0),
+          m_bytes_full(0),
+          m_frames(0)
+      {};
+      /// Destructor
+      ~FrameDiff() {};
+
+      /**
+       * Bring the terminal from the previous frame to the sparkline of
+       * "data"
+       *
+       * @param os Output stream (a terminal)
+       * @param data Input data as array
+       * @param number_of_data_points The number of entries in "data"
+       * @param config Sparkline::Configuration object
+       */
+      template <typename T>
+      void update( std::ostream& os,
+                   const T* const data,
+                   size_t number_of_data_points,
+                   const Sparkline::Configuration<T>& config )
+      {
+        m_next.clear();
+        Sparkline::SparklineTo(m_next, data, number_of_data_points, config);
+        ++m_frames;
+        {
+          Sparkline::CountingSink full;
+          _draw(m_next, full);
+          m_bytes_full += full.size();
+        }
+
+        m_out.clear();
+        if ( not m_drawn or m_next.lines() != m_cells.lines() ) {
+          /// First frame, or a different layout: start over
+          char tmp[32];
+          if ( m_previous_lines > 0 )
+            snprintf(tmp, sizeof(tmp), "\r\x1b[%zuA\x1b[J", m_previous_lines);
+          else
+            snprintf(tmp, sizeof(tmp), "\r\x1b[J");
+          m_out += tmp;
+          Sparkline::StringSink sink(m_out);
+          _draw(m_next, sink);
+          m_previous_lines = m_next.lines()-1;
+          m_drawn = true;
+        } else {
+          _diff(m_out);
+        }
+
+        os << m_out << std::flush;
+        m_bytes_written += m_out.size();
+        m_cells.swap(m_next);
+      }
+
+      /// Total bytes sent to the terminal
+      size_t bytesWritten() const { return m_bytes_written; };
+      /// Total bytes that complete redraws would have sent
+      size_t bytesFull() const { return m_bytes_full; };
+      /// Number of frames
+      size_t frames() const { return m_frames; };
+
+    private:
+      typedef FrameCells::Cell Cell;
+
+      /// Draw one cell at the cursor
+      template <typename Writer>
+      static void _Put( Writer& out,
+                        const Cell& cell )
+      {
+        if ( cell.style == Writer::Plain )
+          out.raw(cell.bytes, cell.length());
+        else
+          out.styled(cell.style, cell.bytes, cell.length());
+      }
+
+      /// Draw a complete frame
+      template <typename Sink>
+      static void _draw( const FrameCells& frame,
+                         Sink& sink )
+      {
+        Sparkline::SparklineWriter<Sink> out(sink, frame.colored());
+        out.setGradient(frame.gradient(), 0);
+        for ( size_t r = 0; r < frame.lines(); ++r ) {
+          if ( r > 0 )
+            out.raw('\n');
+          const Cell* const cells = frame.line(r);
+          for ( size_t c = 0; c < frame.width(r); ++c )
+            _Put(out, cells[c]);
+        }
+        out.close();
+      }
+
+      /// Emit cursor movements and glyphs for all cells of m_next that
+      /// differ from m_cells
+      void _diff( std::string& result )
+      {
+        Sparkline::StringSink sink(result);
+        Sparkline::SparklineWriter<Sparkline::StringSink> out(sink,
+                                                         m_next.colored());
+        out.setGradient(m_next.gradient(), 0);
+
+        /// The cursor rests after the last cell of the last line
+        const size_t last = m_next.lines()-1;
+        size_t row = last;
+        size_t col = m_cells.width(last);
+        char tmp[32];
+
+        for ( size_t r = 0; r < m_next.lines(); ++r ) {
+          const Cell* const now    = m_next.line(r);
+          const Cell* const before = m_cells.line(r);
+          const size_t now_width    = m_next.width(r);
+          const size_t before_width = m_cells.width(r);
+          for ( size_t c = 0; c < now_width; ++c ) {
+            if ( c < before_width and now[c] == before[c] )
+              continue;
+            /// Move the cursor
+            if ( r != row ) {
+              snprintf(tmp, sizeof(tmp), "\x1b[%zu%c",
+                       r < row ? row-r : r-row, r < row ? 'A' : 'B');
+              result += tmp;
+              row = r;
+            }
+            if ( c != col ) {
+              snprintf(tmp, sizeof(tmp), "\x1b[%zuG", c+1);
+              result += tmp;
+              col = c;
+            }
+            _Put(out, now[c]);
+            ++col;
+          }
+          /// The line got shorter: clear the rest
+          if ( now_width < before_width ) {
+            out.close();
+            if ( r != row ) {
+              snprintf(tmp, sizeof(tmp), "\x1b[%zu%c",
+                       r < row ? row-r : r-row, r < row ? 'A' : 'B');
+              result += tmp;
+              row = r;
+            }
+            snprintf(tmp, sizeof(tmp), "\x1b[%zuG\x1b[K", now_width+1);
+            result += tmp;
+            col = now_width;
+          }
+        }
+
+        out.close();
+        /// Park the cursor where a complete redraw would have left it
+        if ( row != last ) {
+          snprintf(tmp, sizeof(tmp), "\x1b[%zuB", last-row);
+          result += tmp;
+        }
+        if ( col != m_next.width(last) ) {
+          snprintf(tmp, sizeof(tmp), "\x1b[%zuG", m_next.width(last)+1);
+          result += tmp;
+        }
+      }
+
+      /// The frame on the terminal, and the one being drawn
+      FrameCells m_cells;
+      FrameCells m_next;
+      std::string m_out;
+      bool m_drawn;
+      size_t m_previous_lines;
+      size_t m_bytes_written;
+      size_t m_bytes_full;
+      size_t m_frames;
+  };
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Follow mode
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Plot the most recent values from a file descriptor until EOF
+   *
+   * A reader thread parses the input and hands the values to the
+   * drawing thread through a lock-free queue, so bursts of input never
+   * wait for the terminal. The drawing thread collects everything that
+   * arrived since the previous frame into a ring buffer and redraws
+   * the plot in place, at most "fps" times per second.
+   *
+   * @param fd The file descriptor to read from (not closed)
+   * @param config Sparkline::Configuration object
+   * @param capacity Plot the last "capacity" values
+   * @param fps Maximum number of redraws per second
+   * @param os Output stream (a terminal)
+   * @param stop_at_invalid Iff TRUE, stop reading at the first token
+   *        that is not a number; else skip such tokens
+   * @param incremental Iff TRUE, only send changed cells (FrameDiff)
+   *        instead of redrawing every frame completely
+   * @param stats Optional stream for output byte statistics
+   */
+  inline void Follow( int fd,
+                      const Sparkline::Configuration<float>& config,
+                      size_t capacity,
+                      float fps,
+                      std::ostream& os,
+                      bool stop_at_invalid=true,
+                      bool incremental=true,
+                      std::ostream* stats=0 )
+  {
+    SpscQueue<float> queue;
+    std::atomic<bool> done(false);
+    /// A read error ends the input; it is rethrown on this thread
+    std::exception_ptr reader_error;
+
+    std::thread reader_thread([&]() {
+      try {
+        DataInput::BufferedReader reader(fd, stop_at_invalid);
+        float value;
+        while ( reader.next(value) )
+          while ( not queue.push(value) )
+            std::this_thread::yield();
+      } catch ( ... ) {
+        reader_error = std::current_exception();
+      }
+      done.store(true, std::memory_order_release);
+    });
+
+    const std::chrono::microseconds frame_time(
+                          (long long)(1e6/std::max(fps, 0.01f)));
+    RingBuffer<float> ring(capacity);
+    std::vector<float> window;
+    Sparkline::Configuration<float> frame_config(config);
+    FrameDiff frames;
+    size_t previous_lines = 0;
+    size_t bytes_written = 0;
+    bool drawn = false;
+
+    while ( true ) {
+      const std::chrono::steady_clock::time_point next_frame =
+                          std::chrono::steady_clock::now() + frame_time;
+      /// Check before draining so that no value is left behind
+      const bool finished = done.load(std::memory_order_acquire);
+
+      bool changed = false;
+      float value;
+      while ( queue.pop(value) ) {
+        ring.push(value);
+        changed = true;
+      }
+
+      if ( changed or (finished and not drawn) ) {
+        ring.linearize(window);
+        if ( not window.empty() ) {
+          const size_t per_character =
+                          Sparkline::ColumnsPerCharacter(config.rendering);
+          frame_config.setWidth(std::min(config.this_many_characters_wide,
+                                         (window.size()+per_character-1)
+                                         / per_character));
+          if ( incremental ) {
+            frames.update(os, window.data(), window.size(), frame_config);
+          } else {
+            const std::string frame = Sparkline::Sparkline(window,
+                                                           frame_config);
+            Redraw(os, frame, previous_lines);
+            bytes_written += frame.size();
+          }
+          drawn = true;
+        }
+      }
+
+      if ( finished )
+        break;
+      std::this_thread::sleep_until(next_frame);
+    }
+
+    reader_thread.join();
+    os << std::endl;
+    if ( reader_error )
+      std::rethrow_exception(reader_error);
+
+    if ( stats ) {
+      if ( incremental )
+        *stats << frames.frames() << " frames, "
+               << frames.bytesWritten() << " bytes written ("
+               << frames.bytesFull() << " for complete redraws)"
+               << std::endl;
+      else
+        *stats << bytes_written << " bytes written" << std::endl;
+    }
+  }
+
+
+}  // namespace LivePlot
+
+
+
+#endif  // LIVEPLOT_H__
+
@@ -0,0 +1,540 @@
+/**
+ * ===================================================================
+ *
+ * Author: Nikolaus Mayer, 2018 (mayern@cs.uni-freiburg.de)
+ *
+ * PyramidIndex
+ *
+ * Multi-resolution sidecar index for plotting huge binary files
+ *
+ * ===================================================================
+ *
+ * Usage example:
+ *
+ * >
+ * > #include <iostream>
+ * > #include "PyramidIndex.h"
+ * >
+ * > int main(int argc, char** argv)
+ * > {
+ * >   DataInput::BinaryLayout layout;
+ * >   DataInput::MappedFile file("data.f32");
+ * >   DataInput::BinaryValues<float> values(file.begin(), file.end(), layout);
+ * >   const PyramidIndex::Header identity =
+ * >           PyramidIndex::Describe("data.f32", DataInput::F32, layout);
+ * >
+ * >   /// Once: scan all values and write "data.f32.pyramid"
+ * >   PyramidIndex::Build(values, identity,
+ * >                       PyramidIndex::SidecarPath("data.f32"));
+ * >
+ * >   /// Any time later: plot in O(width), whatever the file size
+ * >   PyramidIndex::Index index(PyramidIndex::SidecarPath("data.f32"));
+ * >   if ( index.matches(identity) )
+ * >     std::cout << PyramidIndex::Plot(index, values, 0, values.size(),
+ * >                            Sparkline::Configuration<float>(5, 80, true))
+ * >               << std::endl;
+ * >   return 0;
+ * > }
+ * >
+ *
+ * ===================================================================
+ */
+
+#ifndef PYRAMIDINDEX_H__
+#define PYRAMIDINDEX_H__
+
+// System/STL
+#include <algorithm>      // std::min, std::max
+#include <cerrno>
+#include <cstdio>         // std::rename, std::remove
+#include <cstring>        // std::memcmp, std::memcpy, std::strerror
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>       // uint64_t, ...
+#include <fcntl.h>        // open()
+#include <sys/stat.h>     // stat()
+#include <unistd.h>       // write(), close()
+// Local files
+#include "DataInput.h"
+#include "SimdKernels.h"
+#include "Sparkline.h"
+
+
+
+namespace PyramidIndex {
+
+
+  /// Number of values summarized by one aggregate of the finest level
+  /// (a power of two)
+  const size_t BASE_BLOCK = 1024;
+
+  /// File format marker and version
+  const char MAGIC[8] = { 'S','P','Y','R','A','M','I','D' };
+  const uint32_t VERSION = 1;
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// File layout
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Summary of a run of values
+   */
+  struct Aggregate {
+    double minv;
+    double maxv;
+    double sum;
+    uint64_t count;
+
+    /// An aggregate of no values
+    static Aggregate Empty()
+    {
+      Aggregate a;
+      a.minv  = std::numeric_limits<double>::max();
+      a.maxv  = std::numeric_limits<double>::lowest();
+      a.sum   = 0;
+      a.count = 0;
+      return a;
+    }
+
+    /// Include another aggregate
+    void merge( const Aggregate& other )
+    {
+      minv   = std::min(minv, other.minv);
+      maxv   = std::max(maxv, other.maxv);
+      sum   += other.sum;
+      count += other.count;
+    }
+
+    /// Include a run of values
+    template <typename T>
+    void add( const DataInput::BinaryValues<T>& values,
+              size_t first,
+              size_t last )
+    {
+      if ( first >= last )
+        return;
+      const T* const array = values.contiguous();
+      /// Integer values are summed in double, so a block of large
+      /// values cannot wrap around (see SimdKernels::SumType)
+      typename SimdKernels::SumType<T>::type sum_t = 0;
+      T min_t = std::numeric_limits<T>::max();
+      T max_t = std::numeric_limits<T>::lowest();
+      if ( array ) {
+        SimdKernels::SliceStats(array+first, last-first, sum_t, min_t, max_t);
+      } else {
+        for ( size_t i = first; i < last; ++i ) {
+          const T v = values[i];
+          sum_t += v;
+          min_t = std::min(v, min_t);
+          max_t = std::max(v, max_t);
+        }
+      }
+      minv   = std::min(minv, (double)min_t);
+      maxv   = std::max(maxv, (double)max_t);
+      sum   += (double)sum_t;
+      count += last-first;
+    }
+  };
+
+
+  /**
+   * Header of an index file; also describes which data file (and
+   * which interpretation of it) an index belongs to
+   *
+   * The file is followed by the aggregates of all levels, finest level
+   * first. Level l has ceil(values / (base_block * 2^l)) aggregates;
+   * the last level has exactly one. Numbers are stored in host byte
+   * order (a foreign file fails the version check).
+   */
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t offset;
+    uint64_t stride;
+    uint32_t big_endian;
+    uint32_t levels;
+    uint64_t values;
+    uint64_t base_block;
+    uint64_t source_size;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+  };
+
+
+  /**
+   * Describe a data file as it is going to be read
+   *
+   * @param path The data file
+   * @param format Element type of the values
+   * @param layout Offset, stride and byte order of the values
+   *
+   * @returns A header without level information
+   */
+  inline Header Describe( const std::string& path,
+                          DataInput::BinaryFormat format,
+                          const DataInput::BinaryLayout& layout )
+  {
+    static const size_t SIZES[] = { 4, 8, 4, 8, 2 };
+    struct stat st;
+    if ( ::stat(path.c_str(), &st) != 0 )
+      throw std::runtime_error("Cannot stat \"" + path + "\": "
+                               + std::strerror(errno));
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version     = VERSION;
+    header.format      = (uint32_t)format;
+    header.offset      = layout.offset;
+    header.stride      = layout.stride == 0 ? SIZES[format] : layout.stride;
+    header.big_endian  = layout.big_endian ? 1 : 0;
+    header.source_size = (uint64_t)st.st_size;
+    header.source_mtime_sec  = (int64_t)st.st_mtim.tv_sec;
+    header.source_mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    return header;
+  }
+
+
+  /// Where the index of a data file is stored
+  inline std::string SidecarPath( const std::string& path )
+  {
+    return path + ".pyramid";
+  }
+
+
+  /// Number of aggregates of a level
+  inline size_t LevelSize( size_t values,
+                           size_t level )
+  {
+    const size_t blocks = (values+BASE_BLOCK-1)/BASE_BLOCK;
+    return (blocks + ((size_t)1 << level) - 1) >> level;
+  }
+
+
+  /// Number of levels for a number of values
+  inline size_t LevelCount( size_t values )
+  {
+    if ( values == 0 )
+      return 0;
+    size_t levels = 1;
+    while ( LevelSize(values, levels-1) > 1 )
+      ++levels;
+    return levels;
+  }
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Building
+  /// /////////////////////////////////////////////////////////////////
+
+  /// Write a whole buffer to a file descriptor
+  inline void _WriteAll( int fd,
+                         const void* data,
+                         size_t bytes )
+  {
+    const char* p = static_cast<const char*>(data);
+    while ( bytes > 0 ) {
+      const ssize_t n = ::write(fd, p, bytes);
+      if ( n < 0 ) {
+        if ( errno == EINTR )
+          continue;
+        throw std::runtime_error(std::string("write() failed: ")
+                                 + std::strerror(errno));
+      }
+      p     += n;
+      bytes -= (size_t)n;
+    }
+  }
+
+
+  /**
+   * Scan all values once and write their index file
+   *
+   * Only the finest level is computed from the values; every coarser
+   * level merges pairs of the previous one. The file is written under
+   * a temporary name and then renamed, so readers never see a partial
+   * index.
+   *
+   * @param values The data
+   * @param identity Description of the data, see Describe()
+   * @param path Output file, see SidecarPath()
+   *
+   * @returns The size of the index file in bytes
+   */
+  template <typename T>
+  size_t Build( const DataInput::BinaryValues<T>& values,
+                const Header& identity,
+                const std::string& path )
+  {
+    Header header = identity;
+    header.values     = values.size();
+    header.base_block = BASE_BLOCK;
+    header.levels     = (uint32_t)LevelCount(values.size());
+
+    std::vector<Aggregate> level(LevelSize(values.size(), 0));
+    for ( size_t b = 0; b < level.size(); ++b ) {
+      level[b] = Aggregate::Empty();
+      level[b].add(values, b*BASE_BLOCK,
+                   std::min((b+1)*BASE_BLOCK, values.size()));
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if ( fd < 0 )
+      throw std::runtime_error("Cannot create \"" + tmp_path + "\": "
+                               + std::strerror(errno));
+    size_t bytes = sizeof(header);
+    try {
+      _WriteAll(fd, &header, sizeof(header));
+      std::vector<Aggregate> coarser;
+      while ( not level.empty() ) {
+        _WriteAll(fd, level.data(), level.size()*sizeof(Aggregate));
+        bytes += level.size()*sizeof(Aggregate);
+        if ( level.size() == 1 )
+          break;
+        coarser.resize((level.size()+1)/2);
+        for ( size_t b = 0; b < coarser.size(); ++b ) {
+          coarser[b] = level[2*b];
+          if ( 2*b+1 < level.size() )
+            coarser[b].merge(level[2*b+1]);
+        }
+        level.swap(coarser);
+      }
+    } catch ( ... ) {
+      ::close(fd);
+      std::remove(tmp_path.c_str());
+      throw;
+    }
+    if ( ::close(fd) != 0 or std::rename(tmp_path.c_str(), path.c_str()) != 0 )
+      throw std::runtime_error("Cannot write \"" + path + "\": "
+                               + std::strerror(errno));
+    return bytes;
+  }
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Reading
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * A memory-mapped index file
+   *
+   * Only the aggregates that are actually used are paged in.
+   *
+   * @param path The index file, see SidecarPath()
+   */
+  class Index {
+    public:
+      /// Constructor; throws if the file is not a valid index
+      Index( const std::string& path )
+        : m_file(path)
+      {
+        if ( m_file.size() < sizeof(Header) )
+          throw std::runtime_error("\"" + path + "\" is not an index");
+        std::memcpy(&m_header, m_file.begin(), sizeof(Header));
+        if ( std::memcmp(m_header.magic, MAGIC, sizeof(MAGIC)) != 0 or
+             m_header.version != VERSION or
+             m_header.base_block != BASE_BLOCK or
+             m_header.levels != LevelCount(m_header.values) )
+          throw std::runtime_error("\"" + path + "\" is not an index");
+
+        size_t offset = sizeof(Header);
+        for ( size_t l = 0; l < m_header.levels; ++l ) {
+          m_levels.push_back(reinterpret_cast<const Aggregate*>(
+                               m_file.begin()+offset));
+          offset += LevelSize(m_header.values, l)*sizeof(Aggregate);
+        }
+        if ( m_file.size() != offset )
+          throw std::runtime_error("\"" + path + "\" is truncated");
+      };
+      /// Destructor
+      ~Index() {};
+
+      /// TRUE iff the index was built from the data that "identity"
+      /// describes (same file state, same value interpretation)
+      bool matches( const Header& identity ) const
+      {
+        return m_header.format            == identity.format and
+               m_header.offset            == identity.offset and
+               m_header.stride            == identity.stride and
+               m_header.big_endian        == identity.big_endian and
+               m_header.source_size       == identity.source_size and
+               m_header.source_mtime_sec  == identity.source_mtime_sec and
+               m_header.source_mtime_nsec == identity.source_mtime_nsec;
+      }
+
+      const Header& header() const { return m_header; };
+      /// Number of indexed values
+      size_t values() const { return m_header.values; };
+      /// Number of levels
+      size_t levels() const { return m_levels.size(); };
+      /// Aggregates of a level; aggregate i covers the values
+      /// [i*BASE_BLOCK*2^level, (i+1)*BASE_BLOCK*2^level)
+      const Aggregate* level( size_t l ) const { return m_levels[l]; };
+
+    private:
+      DataInput::MappedFile m_file;
+      Header m_header;
+      std::vector<const Aggregate*> m_levels;
+  };
+
+
+  /**
+   * Summarize the values [first, last) exactly
+   *
+   * The range is covered by as few aggregates as possible (at most
+   * two per level); only the unaligned ends, less than BASE_BLOCK
+   * values each, are read from the data itself.
+   *
+   * @param index The index of "values"
+   * @param values The data
+   * @param first Index of the first value
+   * @param last One past the index of the last value
+   * @param out Receives the summary (merged into)
+   */
+  template <typename T>
+  void Summarize( const Index& index,
+                  const DataInput::BinaryValues<T>& values,
+                  size_t first,
+                  size_t last,
+                  Aggregate& out )
+  {
+    /// Unaligned ends
+    const size_t aligned_first = std::min(last,
+                                 (first+BASE_BLOCK-1)/BASE_BLOCK*BASE_BLOCK);
+    const size_t aligned_last  = std::max(aligned_first,
+                                          last/BASE_BLOCK*BASE_BLOCK);
+    out.add(values, first, aligned_first);
+    out.add(values, aligned_last, last);
+
+    /// Whole blocks, climbing up the levels
+    size_t lo = aligned_first/BASE_BLOCK;
+    size_t hi = aligned_last/BASE_BLOCK;
+    for ( size_t l = 0; l < index.levels() and lo < hi; ++l ) {
+      const Aggregate* const level = index.level(l);
+      if ( lo & 1 )
+        out.merge(level[lo++]);
+      if ( hi & 1 )
+        out.merge(level[--hi]);
+      lo /= 2;
+      hi /= 2;
+    }
+  }
+
+
+  /**
+   * Render the values [first, last) of an indexed file into a sink
+   *
+   * Every column is summarized exactly with Summarize(), so this reads
+   * O(width) aggregates and raw values, independent of the range
+   * size. Columns are drawn like area binning of whole data points.
+   * Ranges too short to benefit from the index, and plots with another
+   * decimation or a custom downsampler, are plotted from the raw
+   * values.
+   *
+   * @param sink Receives the output, see Sparkline::StringSink etc.
+   * @param index The index of "values"
+   * @param values The data
+   * @param first Index of the first value to plot
+   * @param last One past the index of the last value to plot
+   * @param config Sparkline::Configuration object
+   */
+  template <typename T, typename Sink>
+  void PlotTo( Sink& sink,
+               const Index& index,
+               const DataInput::BinaryValues<T>& values,
+               size_t first,
+               size_t last,
+               const Sparkline::Configuration<T>& config )
+  {
+    last = std::min(last, values.size());
+    first = std::min(first, last);
+    const size_t n = last-first;
+    if ( n == 0 )
+      throw std::runtime_error("No data to plot");
+    const size_t w = Sparkline::BinCount(config, n);
+
+    /// Short range: reading it costs no more than the index would;
+    /// M4, LTTB and custom downsamplers need every value anyway
+    if ( n < 2*BASE_BLOCK*w or config.decimation != Sparkline::Area
+         or config.downsampler ) {
+      std::vector<T> raw(n);
+      for ( size_t i = 0; i < n; ++i )
+        raw[i] = values[first+i];
+      Sparkline::SparklineTo(sink, raw.data(), n, config);
+      return;
+    }
+
+    Sparkline::SparklineWorkspace& workspace = Sparkline::DefaultWorkspace();
+    workspace.begin(3*Sparkline::SparklineWorkspace::Bytes<T>(w) +
+                    Sparkline::SparklineFromBinsBytes(w));
+    T* const bins     = workspace.take<T>(w);
+    T* const bins_min = workspace.take<T>(w);
+    T* const bins_max = workspace.take<T>(w);
+    for ( size_t c = 0; c < w; ++c ) {
+      const size_t a = first + c*n/w;
+      const size_t b = first + (c+1)*n/w;
+      Aggregate column = Aggregate::Empty();
+      Summarize(index, values, a, b, column);
+      bins_min[c] = (T)column.minv;
+      bins_max[c] = (T)column.maxv;
+      switch ( config.aggregation ) {
+        case Sparkline::Min:    bins[c] = (T)column.minv; break;
+        case Sparkline::Max:
+        case Sparkline::MinMax: bins[c] = (T)column.maxv; break;
+        case Sparkline::Last:   bins[c] = values[b-1]; break;
+        case Sparkline::Sum:
+          bins[c] = SimdKernels::FromSum<T>(column.sum);
+          break;
+        case Sparkline::Mean:
+        default:
+          bins[c] = SimdKernels::FromSum<T>(column.sum/column.count);
+      }
+    }
+
+    /// Use provided min/max values or adapt to data range
+    T minv = std::min(config.minv, std::numeric_limits<T>::max());
+    T maxv = std::max(config.maxv, std::numeric_limits<T>::min());
+    if ( minv == std::numeric_limits<T>::max() and
+         maxv == std::numeric_limits<T>::min() )
+      Sparkline::BinsRange(bins, bins_min, bins_max, w,
+                           config.aggregation, minv, maxv);
+
+    const bool envelope = (config.aggregation == Sparkline::MinMax);
+    Sparkline::SparklineFromBinsTo(sink, bins, w, n, config, minv, maxv,
+                                   envelope ? bins_min : 0, &workspace);
+  }
+
+
+  /**
+   * Generate a sparkline of the values [first, last) of an indexed
+   * file; see PlotTo()
+   *
+   * @returns A std::string containing the sparkline
+   */
+  template <typename T>
+  std::string Plot( const Index& index,
+                    const DataInput::BinaryValues<T>& values,
+                    size_t first,
+                    size_t last,
+                    const Sparkline::Configuration<T>& config )
+  {
+    std::string result;
+    Sparkline::StringSink sink(result);
+    PlotTo(sink, index, values, first, last, config);
+    return result;
+  }
+
+
+}  // namespace PyramidIndex
+
+
+
+#endif  // PYRAMIDINDEX_H__
+
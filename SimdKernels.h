@@ -0,0 +1,487 @@
+/**
+ * ===================================================================
+ *
+ * Author: Nikolaus Mayer, 2018 (mayern@cs.uni-freiburg.de)
+ *
+ * SimdKernels
+ *
+ * Vectorized reductions over contiguous slices of data, with the
+ * instruction set (AVX2, SSE4.1 or plain C++) chosen once at runtime
+ *
+ * ===================================================================
+ *
+ * Usage example:
+ *
+ * >
+ * > #include <limits>
+ * > #include <vector>
+ * > #include "SimdKernels.h"
+ * >
+ * > int main(int argc, char** argv)
+ * > {
+ * >   std::vector<float> data(1000000, 1.f);
+ * >
+ * >   /// Results are accumulated into the given values
+ * >   float sum = 0.f;
+ * >   float minv = std::numeric_limits<float>::max();
+ * >   float maxv = std::numeric_limits<float>::lowest();
+ * >   SimdKernels::SliceStats(data.data(), data.size(), sum, minv, maxv);
+ * >   return 0;
+ * > }
+ * >
+ *
+ * ===================================================================
+ */
+
+#ifndef SIMDKERNELS_H__
+#define SIMDKERNELS_H__
+
+// System/STL
+#include <algorithm>      // std::min, std::max
+#include <cstddef>        // size_t
+#include <limits>
+#include <stdint.h>       // int32_t, int64_t
+#include <type_traits>
+
+/// Vector kernels are only built for x86 with GCC-style function
+/// targets; everywhere else, SliceStats() is plain C++
+#if (defined(__GNUC__) or defined(__clang__)) and \
+    (defined(__x86_64__) or defined(__i386__))
+  #define SIMDKERNELS_X86
+  #include <immintrin.h>
+#endif
+
+
+
+namespace SimdKernels {
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// CPU dispatch
+  /// /////////////////////////////////////////////////////////////////
+
+  /// Instruction sets with a kernel implementation
+  enum Isa
+  {
+    Scalar,
+    SSE41,
+    AVX2
+  };
+
+
+  /**
+   * Query the best instruction set supported by this CPU
+   */
+  inline Isa DetectIsa()
+  {
+    #ifdef SIMDKERNELS_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+      return AVX2;
+    if ( __builtin_cpu_supports("sse4.1") )
+      return SSE41;
+    #endif
+    return Scalar;
+  }
+
+
+  /**
+   * The instruction set used by SliceStats() (detected once)
+   */
+  inline Isa ActiveIsa()
+  {
+    static const Isa isa = DetectIsa();
+    return isa;
+  }
+
+
+  /// Slices shorter than this are not worth the vector setup
+  const size_t MIN_VECTOR_SLICE = 16;
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Sums
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * The type that sums of T values are accumulated in: floating-point
+   * types add in their own type, integer types in double (so that sums
+   * of e.g. u16 values do not wrap around)
+   */
+  template <typename T>
+  struct SumType
+  {
+    typedef typename std::conditional<std::is_floating_point<T>::value,
+                                      T, double>::type type;
+  };
+
+
+  /**
+   * Convert a sum (or a mean computed from it) back to T; integer
+   * types saturate instead of wrapping around
+   *
+   * @param value The sum
+   *
+   * @returns "value" as T
+   */
+  template <typename T, typename S>
+  T FromSum( S value )
+  {
+    if ( std::is_integral<T>::value ) {
+      if ( not (value > (S)std::numeric_limits<T>::lowest()) )
+        return std::numeric_limits<T>::lowest();
+      if ( not (value < (S)std::numeric_limits<T>::max()) )
+        return std::numeric_limits<T>::max();
+    }
+    return (T)value;
+  }
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Scalar kernel
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Accumulate sum, minimum and maximum of a slice
+   *
+   * The result is merged into the values passed in, so consecutive
+   * slices can be combined. NaN values never become the minimum or
+   * maximum, exactly as with std::min/std::max.
+   *
+   * @param first Start of the slice
+   * @param n Number of values in the slice
+   * @param sum Running sum (in/out), see SumType
+   * @param minv Running minimum (in/out)
+   * @param maxv Running maximum (in/out)
+   */
+  template <typename T>
+  void SliceStatsScalar( const T* const first,
+                         size_t n,
+                         typename SumType<T>::type& sum,
+                         T& minv,
+                         T& maxv )
+  {
+    for ( size_t i = 0; i < n; ++i ) {
+      sum += first[i];
+      minv = std::min(minv, first[i]);
+      maxv = std::max(maxv, first[i]);
+    }
+  }
+
+
+
+  #ifdef SIMDKERNELS_X86
+  /// /////////////////////////////////////////////////////////////////
+  /// AVX2 kernels
+  /// /////////////////////////////////////////////////////////////////
+
+  /// The argument order of the min/max intrinsics matters: they return
+  /// the second operand if the comparison fails, which keeps NaN values
+  /// out of the running extremes just like std::min/std::max do.
+
+  __attribute__((target("avx2")))
+  inline void SliceStatsAVX2( const float* const first,
+                              size_t n,
+                              float& sum,
+                              float& minv,
+                              float& maxv )
+  {
+    __m256 s  = _mm256_setzero_ps();
+    __m256 lo = _mm256_set1_ps(minv);
+    __m256 hi = _mm256_set1_ps(maxv);
+    size_t i = 0;
+    for ( ; i+8 <= n; i += 8 ) {
+      const __m256 v = _mm256_loadu_ps(first+i);
+      s  = _mm256_add_ps(s, v);
+      lo = _mm256_min_ps(v, lo);
+      hi = _mm256_max_ps(v, hi);
+    }
+    float lanes_s[8], lanes_lo[8], lanes_hi[8];
+    _mm256_storeu_ps(lanes_s,  s);
+    _mm256_storeu_ps(lanes_lo, lo);
+    _mm256_storeu_ps(lanes_hi, hi);
+    for ( size_t k = 0; k < 8; ++k ) {
+      sum += lanes_s[k];
+      minv = std::min(minv, lanes_lo[k]);
+      maxv = std::max(maxv, lanes_hi[k]);
+    }
+    SliceStatsScalar(first+i, n-i, sum, minv, maxv);
+  }
+
+  __attribute__((target("avx2")))
+  inline void SliceStatsAVX2( const double* const first,
+                              size_t n,
+                              double& sum,
+                              double& minv,
+                              double& maxv )
+  {
+    __m256d s  = _mm256_setzero_pd();
+    __m256d lo = _mm256_set1_pd(minv);
+    __m256d hi = _mm256_set1_pd(maxv);
+    size_t i = 0;
+    for ( ; i+4 <= n; i += 4 ) {
+      const __m256d v = _mm256_loadu_pd(first+i);
+      s  = _mm256_add_pd(s, v);
+      lo = _mm256_min_pd(v, lo);
+      hi = _mm256_max_pd(v, hi);
+    }
+    double lanes_s[4], lanes_lo[4], lanes_hi[4];
+    _mm256_storeu_pd(lanes_s,  s);
+    _mm256_storeu_pd(lanes_lo, lo);
+    _mm256_storeu_pd(lanes_hi, hi);
+    for ( size_t k = 0; k < 4; ++k ) {
+      sum += lanes_s[k];
+      minv = std::min(minv, lanes_lo[k]);
+      maxv = std::max(maxv, lanes_hi[k]);
+    }
+    SliceStatsScalar(first+i, n-i, sum, minv, maxv);
+  }
+
+  __attribute__((target("avx2")))
+  inline void SliceStatsAVX2( const int32_t* const first,
+                              size_t n,
+                              double& sum,
+                              int32_t& minv,
+                              int32_t& maxv )
+  {
+    /// The values are summed in 64-bit lanes, which cannot overflow;
+    /// the total is exact, like that of the scalar loop
+    __m256i s  = _mm256_setzero_si256();
+    __m256i lo = _mm256_set1_epi32(minv);
+    __m256i hi = _mm256_set1_epi32(maxv);
+    size_t i = 0;
+    for ( ; i+8 <= n; i += 8 ) {
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(first+i));
+      s  = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(
+                                 _mm256_castsi256_si128(v)));
+      s  = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(
+                                 _mm256_extracti128_si256(v, 1)));
+      lo = _mm256_min_epi32(v, lo);
+      hi = _mm256_max_epi32(v, hi);
+    }
+    int64_t lanes_s[4];
+    int32_t lanes_lo[8], lanes_hi[8];
+    _mm256_storeu_si256((__m256i*)lanes_s,  s);
+    _mm256_storeu_si256((__m256i*)lanes_lo, lo);
+    _mm256_storeu_si256((__m256i*)lanes_hi, hi);
+    sum += (double)(lanes_s[0] + lanes_s[1] + lanes_s[2] + lanes_s[3]);
+    for ( size_t k = 0; k < 8; ++k ) {
+      minv = std::min(minv, lanes_lo[k]);
+      maxv = std::max(maxv, lanes_hi[k]);
+    }
+    SliceStatsScalar(first+i, n-i, sum, minv, maxv);
+  }
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// SSE4.1 kernels
+  /// /////////////////////////////////////////////////////////////////
+
+  __attribute__((target("sse4.1")))
+  inline void SliceStatsSSE41( const float* const first,
+                               size_t n,
+                               float& sum,
+                               float& minv,
+                               float& maxv )
+  {
+    __m128 s  = _mm_setzero_ps();
+    __m128 lo = _mm_set1_ps(minv);
+    __m128 hi = _mm_set1_ps(maxv);
+    size_t i = 0;
+    for ( ; i+4 <= n; i += 4 ) {
+      const __m128 v = _mm_loadu_ps(first+i);
+      s  = _mm_add_ps(s, v);
+      lo = _mm_min_ps(v, lo);
+      hi = _mm_max_ps(v, hi);
+    }
+    float lanes_s[4], lanes_lo[4], lanes_hi[4];
+    _mm_storeu_ps(lanes_s,  s);
+    _mm_storeu_ps(lanes_lo, lo);
+    _mm_storeu_ps(lanes_hi, hi);
+    for ( size_t k = 0; k < 4; ++k ) {
+      sum += lanes_s[k];
+      minv = std::min(minv, lanes_lo[k]);
+      maxv = std::max(maxv, lanes_hi[k]);
+    }
+    SliceStatsScalar(first+i, n-i, sum, minv, maxv);
+  }
+
+  __attribute__((target("sse4.1")))
+  inline void SliceStatsSSE41( const double* const first,
+                               size_t n,
+                               double& sum,
+                               double& minv,
+                               double& maxv )
+  {
+    __m128d s  = _mm_setzero_pd();
+    __m128d lo = _mm_set1_pd(minv);
+    __m128d hi = _mm_set1_pd(maxv);
+    size_t i = 0;
+    for ( ; i+2 <= n; i += 2 ) {
+      const __m128d v = _mm_loadu_pd(first+i);
+      s  = _mm_add_pd(s, v);
+      lo = _mm_min_pd(v, lo);
+      hi = _mm_max_pd(v, hi);
+    }
+    double lanes_s[2], lanes_lo[2], lanes_hi[2];
+    _mm_storeu_pd(lanes_s,  s);
+    _mm_storeu_pd(lanes_lo, lo);
+    _mm_storeu_pd(lanes_hi, hi);
+    for ( size_t k = 0; k < 2; ++k ) {
+      sum += lanes_s[k];
+      minv = std::min(minv, lanes_lo[k]);
+      maxv = std::max(maxv, lanes_hi[k]);
+    }
+    SliceStatsScalar(first+i, n-i, sum, minv, maxv);
+  }
+
+  __attribute__((target("sse4.1")))
+  inline void SliceStatsSSE41( const int32_t* const first,
+                               size_t n,
+                               double& sum,
+                               int32_t& minv,
+                               int32_t& maxv )
+  {
+    /// 64-bit lanes, as in SliceStatsAVX2()
+    __m128i s  = _mm_setzero_si128();
+    __m128i lo = _mm_set1_epi32(minv);
+    __m128i hi = _mm_set1_epi32(maxv);
+    size_t i = 0;
+    for ( ; i+4 <= n; i += 4 ) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(first+i));
+      s  = _mm_add_epi64(s, _mm_cvtepi32_epi64(v));
+      s  = _mm_add_epi64(s, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+      lo = _mm_min_epi32(v, lo);
+      hi = _mm_max_epi32(v, hi);
+    }
+    int64_t lanes_s[2];
+    int32_t lanes_lo[4], lanes_hi[4];
+    _mm_storeu_si128((__m128i*)lanes_s,  s);
+    _mm_storeu_si128((__m128i*)lanes_lo, lo);
+    _mm_storeu_si128((__m128i*)lanes_hi, hi);
+    sum += (double)(lanes_s[0] + lanes_s[1]);
+    for ( size_t k = 0; k < 4; ++k ) {
+      minv = std::min(minv, lanes_lo[k]);
+      maxv = std::max(maxv, lanes_hi[k]);
+    }
+    SliceStatsScalar(first+i, n-i, sum, minv, maxv);
+  }
+  #endif  // SIMDKERNELS_X86
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Dispatching entry points
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Accumulate sum, minimum and maximum of a slice, using the best
+   * kernel for this CPU (see SliceStatsScalar() for the contract)
+   *
+   * Element types without a vector kernel use the scalar loop. Vector
+   * kernels add in a different order, so floating-point sums may differ
+   * from the scalar loop in the last bits.
+   */
+  template <typename T>
+  void SliceStats( const T* const first,
+                   size_t n,
+                   typename SumType<T>::type& sum,
+                   T& minv,
+                   T& maxv )
+  {
+    SliceStatsScalar(first, n, sum, minv, maxv);
+  }
+
+  #ifdef SIMDKERNELS_X86
+  template <typename T>
+  void _SliceStatsDispatch( const T* const first,
+                            size_t n,
+                            typename SumType<T>::type& sum,
+                            T& minv,
+                            T& maxv )
+  {
+    if ( n < MIN_VECTOR_SLICE ) {
+      SliceStatsScalar(first, n, sum, minv, maxv);
+      return;
+    }
+    switch ( ActiveIsa() ) {
+      case AVX2:  SliceStatsAVX2 (first, n, sum, minv, maxv); break;
+      case SSE41: SliceStatsSSE41(first, n, sum, minv, maxv); break;
+      default:    SliceStatsScalar(first, n, sum, minv, maxv); break;
+    }
+  }
+
+  inline void SliceStats( const float* const first, size_t n,
+                          float& sum, float& minv, float& maxv )
+  {
+    _SliceStatsDispatch(first, n, sum, minv, maxv);
+  }
+
+  inline void SliceStats( const double* const first, size_t n,
+                          double& sum, double& minv, double& maxv )
+  {
+    _SliceStatsDispatch(first, n, sum, minv, maxv);
+  }
+
+  inline void SliceStats( const int32_t* const first, size_t n,
+                          double& sum, int32_t& minv, int32_t& maxv )
+  {
+    _SliceStatsDispatch(first, n, sum, minv, maxv);
+  }
+  #endif  // SIMDKERNELS_X86
+
+
+  /**
+   * Accumulate minimum and maximum of a slice (fused, single pass)
+   *
+   * @param first Start of the slice
+   * @param n Number of values in the slice
+   * @param minv Running minimum (in/out)
+   * @param maxv Running maximum (in/out)
+   */
+  template <typename T>
+  void MinMax( const T* const first,
+               size_t n,
+               T& minv,
+               T& maxv )
+  {
+    for ( size_t i = 0; i < n; ++i ) {
+      minv = std::min(minv, first[i]);
+      maxv = std::max(maxv, first[i]);
+    }
+  }
+
+  #ifdef SIMDKERNELS_X86
+  /// The vector kernels get the sum for free in the same pass
+  inline void MinMax( const float* const first, size_t n,
+                      float& minv, float& maxv )
+  {
+    float sum = 0;
+    _SliceStatsDispatch(first, n, sum, minv, maxv);
+  }
+
+  inline void MinMax( const double* const first, size_t n,
+                      double& minv, double& maxv )
+  {
+    double sum = 0;
+    _SliceStatsDispatch(first, n, sum, minv, maxv);
+  }
+
+  inline void MinMax( const int32_t* const first, size_t n,
+                      int32_t& minv, int32_t& maxv )
+  {
+    double sum = 0;
+    _SliceStatsDispatch(first, n, sum, minv, maxv);
+  }
+  #endif  // SIMDKERNELS_X86
+
+
+}  // namespace SimdKernels
+
+
+
+#endif  // SIMDKERNELS_H__
+
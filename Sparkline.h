@@ -58,16 +58,24 @@
 #define USE_UNICODE_GRAPHICS
 
 // System/STL
+#include <atomic>
 #include <cmath>          // log10
+#include <csignal>        // sigaction, SIGWINCH
+#include <cstdio>         // snprintf
+#include <cstdlib>        // getenv, atoi
+#include <cstring>        // memcpy, strlen
 #include <iomanip>        // std::setw, std::setfill
 #include <iostream>       // std::left
 #include <limits>
 #include <vector>
 #include <sstream>        // std::ostringstream
+#include <stdexcept>      // std::runtime_error
 #include <string>
 #include <sys/ioctl.h>    // ioctl()
 #include <unistd.h>       // STDOUT_FILENO
 // Local files
+#include "SimdKernels.h"
+#include "ThreadPool.h"
 #ifdef WITH_TEXTDECORATOR
   #include "TextDecorator.h"
   #define   RED(x) TD.red(x)
@@ -86,17 +94,123 @@
 /// ///////////////////////////////////////////////////////////////////
 namespace SparklineHelpers {
 
+  /// Terminal width assumed when stdout is not a terminal and
+  /// $COLUMNS is not set
+  const unsigned short int DEFAULT_TERMINAL_WIDTH = 80;
+
+
+  /**
+   * Cached terminal geometry
+   *
+   * The terminal is only queried on first use and after a SIGWINCH
+   * (window resize); all other calls are a memory read. If stdout is
+   * not a terminal, $COLUMNS or a configurable default is used. The
+   * SIGWINCH handler is only installed if the program does not handle
+   * that signal itself; such programs should call refresh() from
+   * their own handler.
+   */
+  class TerminalGeometry {
+    public:
+      /// The process-wide instance
+      static TerminalGeometry& Instance()
+      {
+        static TerminalGeometry geometry;
+        return geometry;
+      }
+
+      /// Terminal width (in characters)
+      unsigned short int width()
+      {
+        if ( _Stale().exchange(false) )
+          m_width = _Query(m_default_width);
+        return m_width;
+      }
+
+      /// Set the width used if stdout is not a terminal and $COLUMNS
+      /// is not set
+      void setDefaultWidth( unsigned short int width )
+      {
+        m_default_width = width;
+        refresh();
+      }
+
+      /// Re-query the terminal at the next width() call;
+      /// async-signal-safe
+      static void refresh()
+      {
+        _Stale() = true;
+      }
+
+    private:
+      /// Constructor
+      TerminalGeometry()
+        : m_width(DEFAULT_TERMINAL_WIDTH),
+          m_default_width(DEFAULT_TERMINAL_WIDTH)
+      {
+        _Stale() = true;
+        _InstallHandler();
+      };
+
+      /// Ask the terminal, then the environment, then use the default
+      static unsigned short int _Query( unsigned short int default_width )
+      {
+        /// Defined in bits/ioctl-types.h
+        struct winsize w;
+        if ( ioctl( STDOUT_FILENO, TIOCGWINSZ, &w ) == 0 and w.ws_col > 0 )
+          return w.ws_col;  // other is .ws_row
+        const char* columns = std::getenv("COLUMNS");
+        if ( columns ) {
+          const int c = std::atoi(columns);
+          if ( c > 0 and c <= std::numeric_limits<unsigned short>::max() )
+            return (unsigned short int)c;
+        }
+        return default_width;
+      }
+
+      /// Install _OnResize() for SIGWINCH unless it is already handled
+      static void _InstallHandler()
+      {
+        #ifdef SIGWINCH
+        struct sigaction previous;
+        if ( sigaction(SIGWINCH, 0, &previous) != 0 or
+             (previous.sa_flags & SA_SIGINFO) or
+             previous.sa_handler != SIG_DFL )
+          return;
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = &TerminalGeometry::_OnResize;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &action, 0);
+        #endif
+      }
+
+      static void _OnResize( int )
+      {
+        refresh();
+      }
+
+      /// TRUE if the cached width must be re-queried
+      static std::atomic<bool>& _Stale()
+      {
+        static std::atomic<bool> stale(true);
+        return stale;
+      }
+
+      std::atomic<unsigned short int> m_width;
+      std::atomic<unsigned short int> m_default_width;
+  };
+
+
   /**
    * Get terminal width
    *
-   * @returns The current terminal width (in characters)
+   * @returns The current terminal width (in characters), see
+   *          TerminalGeometry
    */
-  unsigned short int TerminalWidth()
+  inline unsigned short int TerminalWidth()
   {
-    /// Defined in bits/ioctl-types.h
-    struct winsize w;
-    ioctl( STDOUT_FILENO, TIOCGWINSZ, &w );
-    return w.ws_col;  // other is .ws_row
+    return TerminalGeometry::Instance().width();
   }
 
 
@@ -110,7 +224,7 @@ namespace SparklineHelpers {
    *
    * @returns The number of characters needed to pring "n"
    */
-  size_t CharLength( size_t n )
+  inline size_t CharLength( size_t n )
   {
     return std::ceil(log10(n+1));
   }
@@ -138,6 +252,10 @@ namespace Sparkline {
   /// ^      ^^^^^^^
   const int ENCLOSURE_WIDTH = PREC+8;
 
+  /// Multithreaded downsampling only pays off with at least this many
+  /// data points per thread
+  const size_t PARALLEL_MIN_POINTS_PER_THREAD = 1<<18;
+
   #ifdef USE_UNICODE_GRAPHICS
     /// Available ticks (▁▂▃▄▅▆▇█)
     /// From "The Unicode Standard, Version 7.0 - U2580" (Block elements)
@@ -186,6 +304,281 @@ namespace Sparkline {
 
 
 
+  /// /////////////////////////////////////////////////////////////////
+  /// Aggregation
+  /// /////////////////////////////////////////////////////////////////
+
+  /// How the data points that fall into one character column are
+  /// combined into the value that is drawn
+  enum Aggregation
+  {
+    Mean,      // Area-weighted average (default)
+    Min,
+    Max,
+    MinMax,    // Bar from the column minimum to the column maximum
+    Last,
+    Sum
+  };
+
+
+  /**
+   * Parse an aggregation name ("mean", "min", "max", "minmax", "last",
+   * "sum")
+   *
+   * @param name The aggregation name
+   * @param aggregation Output; only written on success
+   *
+   * @returns FALSE iff "name" is not a known aggregation
+   */
+  inline bool ParseAggregation( const std::string& name,
+                                Aggregation& aggregation )
+  {
+    if      ( name == "mean"   ) aggregation = Mean;
+    else if ( name == "min"    ) aggregation = Min;
+    else if ( name == "max"    ) aggregation = Max;
+    else if ( name == "minmax" ) aggregation = MinMax;
+    else if ( name == "last"   ) aggregation = Last;
+    else if ( name == "sum"    ) aggregation = Sum;
+    else return false;
+    return true;
+  }
+
+
+  /**
+   * Statistics of the data points in one bin, collected in a single
+   * pass: (weighted) sum, minimum, maximum and the latest value.
+   * The sum is kept in SimdKernels::SumType<T>, so integer formats do
+   * not wrap around; only the value drawn is converted back to T.
+   */
+  template <typename T>
+  class BinAccumulator {
+    public:
+      typedef typename SimdKernels::SumType<T>::type Accumulator;
+
+      /// Constructor
+      BinAccumulator()
+        : sum(0),
+          minv(std::numeric_limits<T>::max()),
+          maxv(std::numeric_limits<T>::lowest()),
+          last(0)
+      {};
+
+      /// Add a data point that lies completely inside the bin
+      void add( T value )
+      {
+        sum += value;
+        _extremes(value);
+      }
+
+      /// Add a contiguous run of data points that lie completely
+      /// inside the bin (vectorized, see SimdKernels::SliceStats())
+      void add( const T* const first, size_t n )
+      {
+        if ( n == 0 )
+          return;
+        SimdKernels::SliceStats(first, n, sum, minv, maxv);
+        last = first[n-1];
+      }
+
+      /// Add a data point that only partially overlaps the bin
+      void add( T value, float weight )
+      {
+        if ( weight <= 0.f )
+          return;
+        sum += (Accumulator)weight * value;
+        _extremes(value);
+      }
+
+      /// Add another bin whose sum counts with "weight"
+      void merge( const BinAccumulator& other, float weight=1.f )
+      {
+        if ( weight <= 0.f or other.empty() )
+          return;
+        sum += (Accumulator)weight * other.sum;
+        minv = std::min(minv, other.minv);
+        maxv = std::max(maxv, other.maxv);
+        last = other.last;
+      }
+
+      /// TRUE iff no data point has been added yet
+      bool empty() const { return minv > maxv; };
+
+      /**
+       * The value to draw for this bin
+       *
+       * @param aggregation How the data points are combined
+       * @param mass The number of data points in the bin (for Mean)
+       */
+      T value( Aggregation aggregation,
+               float mass ) const
+      {
+        switch ( aggregation ) {
+          case Min:    return minv;
+          case Max:    return maxv;
+          case MinMax: return maxv;
+          case Last:   return last;
+          case Sum:    return SimdKernels::FromSum<T>(sum);
+          case Mean:
+          default:     return SimdKernels::FromSum<T>(sum/mass);
+        }
+      }
+
+      Accumulator sum;
+      T minv;
+      T maxv;
+      T last;
+
+    private:
+      void _extremes( T value )
+      {
+        minv = std::min(minv, value);
+        maxv = std::max(maxv, value);
+        last = value;
+      }
+  };
+
+
+
+  /// Ways to fill plots that are wider than the number of data points
+  enum Upsampling
+  {
+    Step,
+    Nearest,
+    Linear
+  };
+
+
+  /**
+   * Parse an upsampling name ("step", "nearest", "linear")
+   *
+   * @param name The upsampling name
+   * @param upsampling Output; only written on success
+   *
+   * @returns FALSE iff "name" is not a known upsampling
+   */
+  inline bool ParseUpsampling( const std::string& name,
+                               Upsampling& upsampling )
+  {
+    if      ( name == "step"    ) upsampling = Step;
+    else if ( name == "nearest" ) upsampling = Nearest;
+    else if ( name == "linear"  ) upsampling = Linear;
+    else return false;
+    return true;
+  }
+
+
+  /// Strategy interface, see the "Downsampling" section below
+  template <typename T>
+  class Downsampler;
+
+
+  /// Built-in downsampling strategies
+  enum Decimation
+  {
+    Area,
+    M4,
+    LTTB
+  };
+
+
+  /**
+   * Parse a decimation name ("area", "m4", "lttb")
+   *
+   * @param name The decimation name
+   * @param decimation Output; only written on success
+   *
+   * @returns FALSE iff "name" is not a known decimation
+   */
+  inline bool ParseDecimation( const std::string& name,
+                               Decimation& decimation )
+  {
+    if      ( name == "area" ) decimation = Area;
+    else if ( name == "m4"   ) decimation = M4;
+    else if ( name == "lttb" ) decimation = LTTB;
+    else return false;
+    return true;
+  }
+
+
+  /// Bar colors
+  enum Gradient
+  {
+    Solid,       // BLUE()
+    Palette256,  // Green (low) to red (high), 256-color palette
+    TrueColor    // Green (low) to red (high), 24-bit colors
+  };
+
+
+  /**
+   * Parse a gradient name ("none", "256", "truecolor")
+   *
+   * @param name The gradient name
+   * @param gradient Output; only written on success
+   *
+   * @returns FALSE iff "name" is not a known gradient
+   */
+  inline bool ParseGradient( const std::string& name,
+                             Gradient& gradient )
+  {
+    if      ( name == "none"      ) gradient = Solid;
+    else if ( name == "256"       ) gradient = Palette256;
+    else if ( name == "truecolor" ) gradient = TrueColor;
+    else return false;
+    return true;
+  }
+
+
+  /// Ways to draw the bars
+  enum Rendering
+  {
+    Blocks,  // One column and TICKS levels per character (ticks)
+    Braille  // Two columns and 4 levels per character (Braille dots)
+  };
+
+
+  /**
+   * Parse a rendering name ("blocks", "braille")
+   *
+   * @param name The rendering name
+   * @param rendering Output; only written on success
+   *
+   * @returns FALSE iff "name" is not a known rendering
+   */
+  inline bool ParseRendering( const std::string& name,
+                              Rendering& rendering )
+  {
+    if      ( name == "blocks"  ) rendering = Blocks;
+    else if ( name == "braille" ) rendering = Braille;
+    else return false;
+    return true;
+  }
+
+
+  /// TRUE if bars are drawn with Braille dots (never in ASCII builds,
+  /// which fall back to Blocks)
+  inline bool DrawsBraille( Rendering rendering )
+  {
+    #ifdef USE_UNICODE_GRAPHICS
+      return rendering == Braille;
+    #else
+      (void)rendering;
+      return false;
+    #endif
+  }
+
+  /// Number of plot columns (bins) per character
+  inline size_t ColumnsPerCharacter( Rendering rendering )
+  {
+    return DrawsBraille(rendering) ? 2 : 1;
+  }
+
+  /// Number of bar height levels per line
+  inline unsigned int LevelsPerLine( Rendering rendering )
+  {
+    return DrawsBraille(rendering) ? 4 : TICKS;
+  }
+
+
   /// /////////////////////////////////////////////////////////////////
   /// Configuration
   /// /////////////////////////////////////////////////////////////////
@@ -202,6 +595,28 @@ namespace Sparkline {
    * @param title Optional caption for the plot
    * @param minv Optional minimum value for plot scaling; if used, also specify maxv!
    * @param maxv Optional maximum value for plot scaling
+   * @param aggregation How data points are combined per column
+   *                    (setAggregation(); default: Mean)
+   * @param decimation Built-in downsampling strategy
+   *                   (setDecimation(); default: Area)
+   * @param downsampler Optional custom downsampling strategy; overrides
+   *                    "decimation" (setDownsampler(); not owned)
+   * @param threads Number of threads for downsampling; 0 means one per
+   *                CPU (setThreads(); default: 1)
+   * @param upsampling How plots wider than the data are filled
+   *                   (setUpsampling(); default: Step)
+   * @param show_x_axis Iff FALSE, a boxed plot ends with a plain lower
+   *                    border, without sample index marks (e.g. for
+   *                    all but the last of stacked plots;
+   *                    setXAxis(); default: TRUE)
+   * @param x_offset Index of the first data point, e.g. if a sub-range
+   *                 of a larger series is plotted; shifts the sample
+   *                 index marks (setXOffset(); default: 0)
+   * @param gradient Iff not Solid, every bar is colored by its height
+   *                 (setGradient(); default: Solid)
+   * @param rendering Braille doubles the horizontal resolution (two
+   *                  columns per character, at half the vertical
+   *                  resolution; setRendering(); default: Blocks)
    */
   template <typename T>
   class Configuration {
@@ -221,8 +636,41 @@ namespace Sparkline {
           print_colored(print_colored),
           title(title),
           minv(minv),
-          maxv(maxv)
+          maxv(maxv),
+          aggregation(Mean),
+          decimation(Area),
+          downsampler(0),
+          threads(1),
+          upsampling(Step),
+          show_x_axis(true),
+          x_offset(0),
+          gradient(Solid),
+          rendering(Blocks)
       {};
+      /// Converting constructor; unset min/max values stay unset, set
+      /// ones are clamped to the range of T, a custom downsampler
+      /// (typed on U) is dropped
+      template <typename U>
+      explicit Configuration( const Configuration<U>& other )
+        : this_many_lines_high(other.this_many_lines_high),
+          this_many_characters_wide(other.this_many_characters_wide),
+          enclose_in_box(other.enclose_in_box),
+          print_colored(other.print_colored),
+          title(other.title),
+          minv(_ConvertLimit(other.minv, std::numeric_limits<U>::max(),
+                             std::numeric_limits<T>::max())),
+          maxv(_ConvertLimit(other.maxv, std::numeric_limits<U>::min(),
+                             std::numeric_limits<T>::min())),
+          aggregation(other.aggregation),
+          decimation(other.decimation),
+          downsampler(0),
+          threads(other.threads),
+          upsampling(other.upsampling),
+          show_x_axis(other.show_x_axis),
+          x_offset(other.x_offset),
+          gradient(other.gradient),
+          rendering(other.rendering)
+      {}
       /// Destructor
       ~Configuration() {};
 
@@ -234,6 +682,15 @@ namespace Sparkline {
       void setTitle( const std::string& v ) { title=v; };
       void setMin( T v ) { minv=v; };
       void setMax( T v ) { maxv=v; };
+      void setAggregation( Aggregation v ) { aggregation=v; };
+      void setDecimation( Decimation v ) { decimation=v; };
+      void setDownsampler( const Downsampler<T>* v ) { downsampler=v; };
+      void setThreads( size_t v ) { threads=v; };
+      void setUpsampling( Upsampling v ) { upsampling=v; };
+      void setXAxis( bool v ) { show_x_axis=v; };
+      void setXOffset( size_t v ) { x_offset=v; };
+      void setGradient( Gradient v ) { gradient=v; };
+      void setRendering( Rendering v ) { rendering=v; };
 
       /// Configuration parameters
       size_t this_many_lines_high;
@@ -243,231 +700,1471 @@ namespace Sparkline {
       std::string title;
       T minv;
       T maxv;
+      Aggregation aggregation;
+      Decimation decimation;
+      const Downsampler<T>* downsampler;
+      size_t threads;
+      Upsampling upsampling;
+      bool show_x_axis;
+      size_t x_offset;
+      Gradient gradient;
+      Rendering rendering;
+
+    private:
+      /// A min/max limit of another type: "unset" maps to "unset_t",
+      /// NaNs stay unset and anything else is clamped to T's range,
+      /// since casting an out-of-range float to an integer is undefined
+      template <typename U>
+      static T _ConvertLimit( U v,
+                              U unset,
+                              T unset_t )
+      {
+        if ( v == unset or v != v )
+          return unset_t;
+        /// long double holds every value of the supported types
+        const long double x = v;
+        if ( x <= (long double)std::numeric_limits<T>::lowest() )
+          return std::numeric_limits<T>::lowest();
+        if ( x >= (long double)std::numeric_limits<T>::max() )
+          return std::numeric_limits<T>::max();
+        return (T)v;
+      }
   };
 
 
 
 
 
+  /// /////////////////////////////////////////////////////////////////
+  /// Quantization
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * A plot reduced to integer bar heights: for every column, the
+   * highest (and optionally lowest) filled tick level, counted over
+   * all lines of the plot
+   *
+   * quantize() does all floating-point work once; emitting the lines
+   * afterwards only compares integers. Keep an instance to re-emit
+   * the same plot cheaply, e.g. in different styles (see
+   * SparklineFromQuantizedTo()).
+   */
+  class QuantizedSparkline {
+    public:
+      /// Constructor
+      QuantizedSparkline()
+        : m_lines(0),
+          m_width(0),
+          m_levels_per_line(TICKS)
+      {};
+      /// Destructor
+      ~QuantizedSparkline() {};
+
+      /// Largest plot height (in lines) that quantize() accepts
+      static size_t MaxLines() { return 65534/TICKS; };
+
+      /**
+       * Quantize bins into tick levels
+       *
+       * @param bins One value per character column
+       * @param number_of_bins The number of entries in "bins"
+       * @param minv Lower end of the plot range
+       * @param maxv Upper end of the plot range
+       * @param this_many_lines_high Line height of the plot
+       * @param lower_bins Optional lower end of every column
+       * @param levels_per_line Number of levels per line: TICKS, or 4
+       *        for Braille dots
+       */
+      template <typename T>
+      void quantize( const T* const bins,
+                     size_t number_of_bins,
+                     T minv,
+                     T maxv,
+                     size_t this_many_lines_high,
+                     const T* const lower_bins=0,
+                     unsigned int levels_per_line=TICKS )
+      {
+        if ( this_many_lines_high > MaxLines() or
+             levels_per_line > TICKS )
+          throw std::runtime_error("QuantizedSparkline: plot too high");
+        m_lines = this_many_lines_high;
+        m_width = number_of_bins;
+        m_levels_per_line = levels_per_line;
+        /// Never shrinks, so a kept instance stops allocating
+        if ( m_top.size() < m_width )
+          m_top.resize(m_width);
+        if ( m_bottom.size() < m_width )
+          m_bottom.resize(m_width);
+
+        const size_t levels = this_many_lines_high*levels_per_line-1;
+        for ( size_t i = 0; i < number_of_bins; ++i ) {
+          m_top[i] = _Level(bins[i], minv, maxv, levels);
+          m_bottom[i] = lower_bins ? _Level(lower_bins[i], minv, maxv, levels)
+                                   : 0;
+        }
+      }
+
+      /// Plot height in lines
+      size_t lines() const { return m_lines; };
+      /// Plot width in columns
+      size_t width() const { return m_width; };
+      /// Number of levels per line
+      unsigned int levelsPerLine() const { return m_levels_per_line; };
+
+      /// Per column: 1 + highest filled tick level, or 0 if empty
+      const uint16_t* top() const { return m_top.data(); };
+      /// Per column: 1 + lowest filled tick level, or 0 if the column
+      /// reaches down to the bottom
+      const uint16_t* bottom() const { return m_bottom.data(); };
+
+      /**
+       * The cell code of a column in one line (0 = bottom line): 0 for
+       * a blank cell, otherwise 1 + tick index (TICKS = solid)
+       */
+      unsigned int cell( size_t line,
+                         size_t column ) const
+      {
+        const unsigned int line_min = line*TICKS;
+        const unsigned int top = m_top[column];
+        if ( top <= line_min or m_bottom[column] > line_min+TICKS )
+          return 0;
+        return std::min(top-line_min, TICKS);
+      }
+
+      /**
+       * Emit one line of cells (0 = bottom line) through a writer
+       * with cell()/endCells() methods, see SparklineWriter (cells
+       * also get the bar height of their column, for gradients)
+       */
+      template <typename Writer>
+      void emitLine( Writer& out,
+                     size_t line ) const
+      {
+        for ( size_t i = 0; i < m_width; ++i )
+          out.cell(cell(line, i), m_top[i]);
+        out.endCells();
+      }
+
+      /**
+       * Braille dot patterns of one line (0 = bottom line), for
+       * characters first ... first+count-1; needs 4 levels per line
+       *
+       * Character c covers columns 2c and 2c+1. The filled levels of a
+       * column within the line are packed into 4 bits, which a table
+       * spreads onto the dot bits of U+2800 (left: dots 7,3,2,1; right:
+       * dots 8,6,5,4, bottom to top).
+       *
+       * @param masks Output, "count" dot patterns (0 = no dots)
+       * @param heights Output, "count" bar heights (the higher column)
+       */
+      void brailleLine( size_t line,
+                        size_t first,
+                        size_t count,
+                        uint8_t* masks,
+                        unsigned int* heights ) const
+      {
+        static const uint8_t left[16]  = { 0x00, 0x40, 0x04, 0x44,
+                                           0x02, 0x42, 0x06, 0x46,
+                                           0x01, 0x41, 0x05, 0x45,
+                                           0x03, 0x43, 0x07, 0x47 };
+        static const uint8_t right[16] = { 0x00, 0x80, 0x20, 0xa0,
+                                           0x10, 0x90, 0x30, 0xb0,
+                                           0x08, 0x88, 0x28, 0xa8,
+                                           0x18, 0x98, 0x38, 0xb8 };
+        const unsigned int line_min = line*4;
+        for ( size_t c = 0; c < count; ++c ) {
+          const size_t i = 2*(first+c);
+          masks[c]   = left[_dots(i, line_min)];
+          heights[c] = m_top[i];
+          if ( i+1 < m_width ) {
+            masks[c] |= right[_dots(i+1, line_min)];
+            heights[c] = std::max(heights[c], (unsigned int)m_top[i+1]);
+          }
+        }
+      }
+
+      /**
+       * Emit one line of Braille characters (0 = bottom line) through
+       * a writer with braille()/endCells() methods, see SparklineWriter
+       */
+      template <typename Writer>
+      void emitBrailleLine( Writer& out,
+                            size_t line ) const
+      {
+        const size_t characters = (m_width+1)/2;
+        uint8_t masks[64];
+        unsigned int heights[64];
+        for ( size_t first = 0; first < characters; first += 64 ) {
+          const size_t count = std::min((size_t)64, characters-first);
+          brailleLine(line, first, count, masks, heights);
+          for ( size_t c = 0; c < count; ++c )
+            out.braille(masks[c], heights[c]);
+        }
+        out.endCells();
+      }
+
+    private:
+      /// Filled levels of a column among the 4 levels from "line_min"
+      /// (bit r = level line_min+r)
+      unsigned int _dots( size_t column,
+                          unsigned int line_min ) const
+      {
+        const unsigned int top = m_top[column];
+        const unsigned int bottom = std::max(1u, (unsigned int)m_bottom[column]) - 1;
+        const unsigned int hi = std::min(std::max(top, line_min) - line_min, 4u);
+        const unsigned int lo = std::min(std::max(bottom, line_min) - line_min, 4u);
+        return ((1u << hi) - 1) & ~((1u << lo) - 1);
+      }
+
+      /// 1 + tick level of "value"; 0 if it cannot be placed (no range)
+      template <typename T>
+      static uint16_t _Level( T value,
+                              T minv,
+                              T maxv,
+                              size_t levels )
+      {
+        const T _data = std::min(maxv, std::max(minv, value));
+        float fraction = (float)(_data-minv)/(float)(maxv-minv);
+        if ( not (fraction == fraction) )
+          return 0;
+        return (uint16_t)(1+std::floor(fraction*levels));
+      }
+
+      size_t m_lines;
+      size_t m_width;
+      unsigned int m_levels_per_line;
+      std::vector<uint16_t> m_top;
+      std::vector<uint16_t> m_bottom;
+  };
+
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Workspace
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Scratch memory for Sparkline() calls
+   *
+   * A render first calls begin() with the total number of bytes it
+   * needs, then carves its arrays out with take(). The storage only
+   * ever grows, so a workspace that is kept across calls stops
+   * allocating once it has seen the widest plot. Sparkline() calls
+   * without an explicit workspace use one per thread (see
+   * DefaultWorkspace()).
+   */
+  class SparklineWorkspace {
+    public:
+      /// Constructor
+      SparklineWorkspace()
+        : m_used(0)
+      {};
+      /// Destructor
+      ~SparklineWorkspace() {};
+
+      /// Bytes to reserve for an array of "count" elements of type U
+      template <typename U>
+      static size_t Bytes( size_t count )
+      {
+        return count*sizeof(U) + alignof(U);
+      }
+
+      /**
+       * Start a new render; all arrays handed out before are released
+       *
+       * @param bytes Total scratch size of this render, see Bytes()
+       */
+      void begin( size_t bytes )
+      {
+        if ( m_storage.size() < bytes )
+          m_storage.resize(bytes);
+        m_used = 0;
+      }
+
+      /**
+       * Hand out an (uninitialized) array of "count" elements of
+       * type U
+       */
+      template <typename U>
+      U* take( size_t count )
+      {
+        const size_t offset = (m_used + alignof(U)-1) & ~(alignof(U)-1);
+        if ( offset + count*sizeof(U) > m_storage.size() )
+          throw std::runtime_error("SparklineWorkspace: begin() reserved "
+                                   "too little memory");
+        m_used = offset + count*sizeof(U);
+        return reinterpret_cast<U*>(m_storage.data() + offset);
+      }
+
+      /// Number of bytes currently allocated
+      size_t capacity() const { return m_storage.size(); };
+
+      /// Quantized form of the plot being rendered
+      QuantizedSparkline& quantized() { return m_quantized; };
+
+    private:
+      /// operator new aligns this for any fundamental type
+      std::vector<char> m_storage;
+      size_t m_used;
+      QuantizedSparkline m_quantized;
+  };
+
+
+  /**
+   * The workspace used by Sparkline() calls of the current thread that
+   * do not pass their own
+   */
+  inline SparklineWorkspace& DefaultWorkspace()
+  {
+    static thread_local SparklineWorkspace workspace;
+    return workspace;
+  }
+
+
+
   /// /////////////////////////////////////////////////////////////////
   /// Sparklines
   /// /////////////////////////////////////////////////////////////////
 
 
   /**
-   * Generate sparkline from data and return string representation
+   * Compute the character width of a plot
+   *
+   * @param this_many_characters_wide Requested width; 0 means as many
+   *        characters as there are data points
+   * @param number_of_data_points The number of data points
+   * @param enclose_in_box Iff TRUE, leave room for the box outline
+   *        and the value labels
+   *
+   * @returns The requested width, limited so that the plot does not
+   *          spill over the terminal boundaries
+   */
+  inline size_t PlotWidth( size_t this_many_characters_wide,
+                           size_t number_of_data_points,
+                           bool enclose_in_box )
+  {
+    size_t max_width = (size_t)SparklineHelpers::TerminalWidth();
+    if ( enclose_in_box ) 
+      max_width -= ENCLOSURE_WIDTH;
+
+    if ( this_many_characters_wide == 0 )
+      this_many_characters_wide = number_of_data_points;
+
+    if ( max_width < this_many_characters_wide )
+      this_many_characters_wide = max_width;
+
+    return this_many_characters_wide;
+  }
+
+
+  /**
+   * Number of plot columns (bins) for a configuration: PlotWidth()
+   * characters, two columns each for Braille
+   *
+   * @param config Sparkline::Configuration object
+   * @param number_of_data_points The number of data points
+   *
+   * @returns The number of bins to reduce the data to
+   */
+  template <typename T>
+  size_t BinCount( const Configuration<T>& config,
+                   size_t number_of_data_points )
+  {
+    const size_t per_character = ColumnsPerCharacter(config.rendering);
+    return per_character *
+           PlotWidth(config.this_many_characters_wide,
+                     (number_of_data_points+per_character-1)/per_character,
+                     config.enclose_in_box);
+  }
+
+
+  /**
+   * Area-weighted binning: combine the data points that fall into
+   * each of "number_of_bins" equally wide bins. Points on a bin
+   * boundary contribute proportionally to both bins. The minimum and
+   * maximum of every bin are collected in the same pass.
    *
    * @param data Input data as array
    * @param number_of_data_points The number of entries in "data"
-   * @param this_many_lines_high Line height of the plot (use higher
-   *        plots to see more details in the data)
-   * @param this_many_characters_wide Character width of the plot; if 
-   *        unspecified, the plot will be as many characters wide as
-   *        there are data points
-   * @param enclose_in_box Iff TRUE, the sparkline plot will be 
-   *        surrounded by a box outline
-   * @param title Optional caption for the plot
-   * @param minv Optional minimum value for plot scaling; if used, also 
-   *        specify maxv!
-   * @param maxv Optional maximum value for plot scaling
+   * @param bins Output array with "number_of_bins" entries
+   * @param bins_min Output array with the minimum of every bin
+   * @param bins_max Output array with the maximum of every bin
+   * @param number_of_bins The number of bins (at most
+   *        "number_of_data_points")
+   * @param aggregation How the data points of a bin are combined
+   *        into "bins"
+   * @param first_bin Only compute bins from this one ...
+   * @param last_bin ... up to (excluding) this one; the output arrays
+   *        are still indexed from bin 0 (default: all bins)
+   */
+  template <typename T>
+  void AreaBinning( const T* const data,
+                    size_t number_of_data_points,
+                    T* bins,
+                    T* bins_min,
+                    T* bins_max,
+                    size_t number_of_bins,
+                    Aggregation aggregation=Mean,
+                    size_t first_bin=0,
+                    size_t last_bin=std::numeric_limits<size_t>::max() )
+  {
+    const float w_scale = (float)number_of_bins/number_of_data_points;
+    const float mass_per_bin = 1/w_scale;
+    last_bin = std::min(last_bin, number_of_bins);
+
+    for ( size_t i = first_bin; i < last_bin; ++i ) {
+      BinAccumulator<T> bin;
+
+      /// Bin boundaries depend only on the bin index, so any range of
+      /// bins gives the same result as a full pass
+      const float lower = i/w_scale;
+      const float upper = (i+1)/w_scale;
+      bin.add(data[(size_t)lower], 1.f-(lower-(size_t)lower));
+      if ((size_t)upper > (size_t)lower+1) {
+        bin.add(data+(size_t)lower+1, (size_t)upper-(size_t)lower-1);
+      }
+      if ((size_t)upper < number_of_data_points) {
+        bin.add(data[(size_t)upper], upper-(size_t)upper);
+      }
+
+      bins[i]     = bin.value(aggregation, mass_per_bin);
+      bins_min[i] = bin.minv;
+      bins_max[i] = bin.maxv;
+    }
+  }
+
+
+  /**
+   * Fill more bins than there are data points. Every bin shows a
+   * single value, so the aggregation does not matter; bins_min and
+   * bins_max equal the bin value.
    *
-   * @returns A std::string containing the sparkline for "data"
+   * Step: bin i shows the data point whose slot [j, j+1) contains the
+   *       left edge of the bin (each point is held for n/w bins)
+   * Nearest: bins are spread so that the first and last bins show
+   *       the first and last data points; each bin shows the closest
+   *       data point
+   * Linear: as Nearest, but interpolating between neighbouring points
+   *
+   * @param data Input data as array
+   * @param number_of_data_points The number of entries in "data"
+   * @param bins Output array with "number_of_bins" entries
+   * @param bins_min Output array, same as "bins"
+   * @param bins_max Output array, same as "bins"
+   * @param number_of_bins The number of bins (more than
+   *        "number_of_data_points")
+   * @param upsampling How the bins are filled
    */
-  template <typename T>  /*implicit parameter*/
-  std::string Sparkline( const T* const data,
-                         size_t number_of_data_points,
-                         size_t this_many_lines_high=1,
-                         size_t this_many_characters_wide=0,
-                         bool enclose_in_box=false,
-                         bool print_colored=true,
-                         std::string title="",
-                         T minv=std::numeric_limits<T>::max(),
-                         T maxv=std::numeric_limits<T>::min()
-                       ) 
+  template <typename T>
+  void Upsample( const T* const data,
+                 size_t number_of_data_points,
+                 T* bins,
+                 T* bins_min,
+                 T* bins_max,
+                 size_t number_of_bins,
+                 Upsampling upsampling )
   {
-    /// Use provided min/max values or adapt to data range
-    minv = std::min(minv, std::numeric_limits<T>::max());
-    maxv = std::max(maxv, std::numeric_limits<T>::min());
-    if ( minv == std::numeric_limits<T>::max() and
-         maxv == std::numeric_limits<T>::min() ) {
-      for ( size_t i = 0; i < number_of_data_points; ++i ) {
-        minv = std::min(minv, data[i]);
-        maxv = std::max(maxv, data[i]);
+    const size_t n = number_of_data_points;
+    const size_t w = number_of_bins;
+    /// Position of bin i on the data index axis for Nearest/Linear
+    const double scale = (w > 1) ? (double)(n-1)/(w-1) : 0.;
+
+    for ( size_t i = 0; i < w; ++i ) {
+      T value;
+      switch ( upsampling ) {
+        case Nearest: {
+          value = data[(size_t)(i*scale + 0.5)];
+          break;
+        }
+        case Linear: {
+          const double x = i*scale;
+          const size_t j = std::min((size_t)x, n-1);
+          const double t = x-j;
+          value = ( j+1 < n and t > 0. )
+                  ? (T)((1.-t)*data[j] + t*data[j+1])
+                  : data[j];
+          break;
+        }
+        case Step:
+        default: {
+          value = data[i*n/w];
+          break;
+        }
+      }
+      bins[i] = bins_min[i] = bins_max[i] = value;
+    }
+  }
+
+
+  /**
+   * Determine the plot range from binned data
+   *
+   * For Mean and MinMax plots, this is the range of the data itself;
+   * otherwise it is the range of the drawn values.
+   *
+   * @param bins One value per character column
+   * @param bins_min The minimum of every column
+   * @param bins_max The maximum of every column
+   * @param number_of_bins The number of columns
+   * @param aggregation How the data points of a column were combined
+   * @param minv Output: lower end of the range
+   * @param maxv Output: upper end of the range
+   */
+  template <typename T>
+  void BinsRange( const T* const bins,
+                  const T* const bins_min,
+                  const T* const bins_max,
+                  size_t number_of_bins,
+                  Aggregation aggregation,
+                  T& minv,
+                  T& maxv )
+  {
+    for ( size_t i = 0; i < number_of_bins; ++i ) {
+      if ( aggregation == Mean or aggregation == MinMax ) {
+        minv = std::min(minv, bins_min[i]);
+        maxv = std::max(maxv, bins_max[i]);
+      } else {
+        minv = std::min(minv, bins[i]);
+        maxv = std::max(maxv, bins[i]);
+      }
+    }
+  }
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Downsampling
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Interface for strategies that reduce the data to one value (plus
+   * the min/max range) per character column
+   */
+  template <typename T>
+  class Downsampler {
+    public:
+      /// Destructor
+      virtual ~Downsampler() {};
+
+      /**
+       * Reduce "data" to "number_of_bins" columns
+       *
+       * @param data Input data as array
+       * @param number_of_data_points The number of entries in "data"
+       * @param bins Output array: the value drawn for every column
+       * @param bins_min Output array: the minimum of every column
+       * @param bins_max Output array: the maximum of every column
+       * @param number_of_bins The number of columns (at most
+       *        "number_of_data_points")
+       * @param aggregation Requested aggregation (may be ignored)
+       */
+      void operator()( const T* const data,
+                       size_t number_of_data_points,
+                       T* bins,
+                       T* bins_min,
+                       T* bins_max,
+                       size_t number_of_bins,
+                       Aggregation aggregation ) const
+      {
+        columns(data, number_of_data_points,
+                bins, bins_min, bins_max, number_of_bins,
+                aggregation, 0, number_of_bins);
+      }
+
+      /**
+       * Compute only the columns "first_column" up to (excluding)
+       * "last_column"; parameters as for operator(), output arrays
+       * are indexed from column 0
+       */
+      virtual void columns( const T* const data,
+                            size_t number_of_data_points,
+                            T* bins,
+                            T* bins_min,
+                            T* bins_max,
+                            size_t number_of_bins,
+                            Aggregation aggregation,
+                            size_t first_column,
+                            size_t last_column ) const = 0;
+
+      /// Iff TRUE, columns are drawn from "bins_min" up to "bins"
+      virtual bool envelope() const { return false; };
+
+      /// Iff TRUE, ranges of columns can be computed independently
+      /// (and thus concurrently)
+      virtual bool separable() const { return true; };
+  };
+
+
+  /**
+   * Area-weighted binning, see AreaBinning() (default)
+   */
+  template <typename T>
+  class AreaDownsampler : public Downsampler<T> {
+    public:
+      void columns( const T* const data,
+                    size_t number_of_data_points,
+                    T* bins,
+                    T* bins_min,
+                    T* bins_max,
+                    size_t number_of_bins,
+                    Aggregation aggregation,
+                    size_t first_column,
+                    size_t last_column ) const
+      {
+        AreaBinning(data, number_of_data_points,
+                    bins, bins_min, bins_max, number_of_bins,
+                    aggregation, first_column, last_column);
+      }
+  };
+
+
+  /**
+   * M4 decimation (Jugel et al., "M4: A Visualization-Oriented Time
+   * Series Data Aggregation", VLDB 2014)
+   *
+   * Every data point belongs to exactly one pixel column, found with
+   * integer arithmetic only. Per column, the first, last, minimum and
+   * maximum values are all that a line or bar rendering can show;
+   * first and last always lie inside the min/max range, so columns are
+   * drawn as min/max envelopes. The value in "bins" follows the
+   * requested aggregation (Last: last point; Min: minimum; otherwise
+   * the maximum, which is the top of the envelope).
+   */
+  template <typename T>
+  class M4Downsampler : public Downsampler<T> {
+    public:
+      void columns( const T* const data,
+                    size_t number_of_data_points,
+                    T* bins,
+                    T* bins_min,
+                    T* bins_max,
+                    size_t number_of_bins,
+                    Aggregation aggregation,
+                    size_t first_column,
+                    size_t last_column ) const
+      {
+        for ( size_t i = first_column; i < last_column; ++i ) {
+          const size_t first = i*number_of_data_points/number_of_bins;
+          const size_t last  = (i+1)*number_of_data_points/number_of_bins;
+          T minv = data[first];
+          T maxv = data[first];
+          SimdKernels::MinMax(data+first+1, last-first-1, minv, maxv);
+          bins_min[i] = minv;
+          bins_max[i] = maxv;
+          switch ( aggregation ) {
+            case Last: bins[i] = data[last-1]; break;
+            case Min:  bins[i] = minv; break;
+            default:   bins[i] = maxv; break;
+          }
+        }
+      }
+
+      bool envelope() const { return true; };
+  };
+
+
+  /**
+   * Largest-Triangle-Three-Buckets decimation (Steinarsson, "Downsampling
+   * Time Series for Visual Representation", 2013)
+   *
+   * The first and last columns show the first and last data point.
+   * Every column in between shows the one point of its bucket that
+   * forms the largest triangle with the point chosen for the previous
+   * column and the average of the next bucket, which keeps the visual
+   * shape of the curve. The aggregation is ignored.
+   */
+  template <typename T>
+  class LttbDownsampler : public Downsampler<T> {
+    public:
+      void columns( const T* const data,
+                    size_t number_of_data_points,
+                    T* bins,
+                    T* bins_min,
+                    T* bins_max,
+                    size_t number_of_bins,
+                    Aggregation /*aggregation*/,
+                    size_t first_column,
+                    size_t last_column ) const
+      {
+        const size_t n = number_of_data_points;
+        const size_t w = number_of_bins;
+        if ( w < 3 or w >= n ) {
+          AreaBinning(data, n, bins, bins_min, bins_max, w,
+                      Mean, first_column, last_column);
+          return;
+        }
+
+        /// Buckets 1..w-2 split the points 1..n-2 evenly
+        const double bucket = (double)(n-2)/(w-2);
+        size_t a = 0;  // index of the previously selected point
+        for ( size_t i = 0; i < w; ++i ) {
+          size_t first, last;
+          if      ( i == 0 )   { first = 0;   last = 1; }
+          else if ( i == w-1 ) { first = n-1; last = n; }
+          else {
+            first = 1+(size_t)((i-1)*bucket);
+            last  = 1+(size_t)(i*bucket);
+          }
+
+          size_t selected = first;
+          T minv = data[first];
+          T maxv = data[first];
+          if ( i > 0 and i < w-1 ) {
+            /// Average of the next bucket (or the last point)
+            const size_t next_first = last;
+            const size_t next_last  = (i+1 == w-1) ? n
+                                      : 1+(size_t)((i+1)*bucket);
+            double avg_y = 0.;
+            for ( size_t j = next_first; j < next_last; ++j )
+              avg_y += data[j];
+            avg_y /= (next_last-next_first);
+            const double avg_x = 0.5*(next_first+next_last-1);
+
+            /// The triangle area (times two) is linear in the candidate
+            /// point: |dx*y + dy*x + c|
+            const double dx = (double)a-avg_x;
+            const double dy = avg_y-data[a];
+            const double c  = -dx*data[a] - dy*a;
+            double max_area = -1.;
+            for ( size_t j = first; j < last; ++j ) {
+              const double area = std::fabs(dx*data[j] + dy*j + c);
+              if ( area > max_area ) {
+                max_area = area;
+                selected = j;
+              }
+              minv = std::min(minv, data[j]);
+              maxv = std::max(maxv, data[j]);
+            }
+          }
+
+          if ( i >= first_column and i < last_column ) {
+            bins[i]     = data[selected];
+            bins_min[i] = minv;
+            bins_max[i] = maxv;
+          }
+          a = selected;
+        }
+      }
+
+      /// Every selected point depends on the one before
+      bool separable() const { return false; };
+  };
+
+
+  /**
+   * Get the shared instance of a built-in downsampling strategy
+   */
+  template <typename T>
+  const Downsampler<T>& BuiltinDownsampler( Decimation decimation )
+  {
+    static const AreaDownsampler<T> area;
+    static const M4Downsampler<T>   m4;
+    static const LttbDownsampler<T> lttb;
+    switch ( decimation ) {
+      case M4:   return m4;
+      case LTTB: return lttb;
+      case Area:
+      default:   return area;
+    }
+  }
+
+
+
+  /**
+   * Run a Downsampler, splitting the columns into contiguous ranges
+   * for multiple threads if the input is large enough; the per-column
+   * minima and maxima (and thus the plot range) come out of the same
+   * parallel pass
+   *
+   * If there are more bins than data points, the data is upsampled
+   * instead (see Upsample()).
+   *
+   * @param downsampler The downsampling strategy
+   * @param threads Maximum number of threads; 0 means one per CPU
+   * @param upsampling How to fill more bins than data points
+   *
+   * See Downsampler::operator() for the other parameters.
+   */
+  template <typename T>
+  void Downsample( const Downsampler<T>& downsampler,
+                   const T* const data,
+                   size_t number_of_data_points,
+                   T* bins,
+                   T* bins_min,
+                   T* bins_max,
+                   size_t number_of_bins,
+                   Aggregation aggregation,
+                   size_t threads,
+                   Upsampling upsampling=Step )
+  {
+    if ( number_of_bins > number_of_data_points ) {
+      Upsample(data, number_of_data_points,
+               bins, bins_min, bins_max, number_of_bins, upsampling);
+      return;
+    }
+
+    if ( threads == 0 )
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, number_of_bins);
+    threads = std::min(threads, number_of_data_points/
+                                PARALLEL_MIN_POINTS_PER_THREAD);
+
+    if ( threads < 2 or not downsampler.separable() ) {
+      downsampler(data, number_of_data_points,
+                  bins, bins_min, bins_max, number_of_bins,
+                  aggregation);
+      return;
+    }
+
+    ThreadPool::ParallelFor(threads, threads, [&]( size_t task ) {
+      downsampler.columns(data, number_of_data_points,
+                          bins, bins_min, bins_max, number_of_bins,
+                          aggregation,
+                          task*number_of_bins/threads,
+                          (task+1)*number_of_bins/threads);
+    });
+  }
+
+
+  /// /////////////////////////////////////////////////////////////////
+  /// Output sinks
+  /// /////////////////////////////////////////////////////////////////
+
+  /// A sink is anything with a "void write(const char*, size_t)"
+  /// method; rendering only ever appends bytes to it.
+
+  /**
+   * Append to a std::string (which only allocates when its capacity
+   * is exceeded)
+   */
+  class StringSink {
+    public:
+      explicit StringSink( std::string& out ) : m_out(out) {};
+      void write( const char* data, size_t n ) { m_out.append(data, n); }
+    private:
+      std::string& m_out;
+  };
+
+
+  /**
+   * Write into a fixed buffer; bytes beyond its capacity are dropped
+   * but still counted
+   */
+  class BufferSink {
+    public:
+      BufferSink( char* out, size_t capacity )
+        : m_out(out), m_capacity(capacity), m_size(0)
+      {};
+      void write( const char* data, size_t n )
+      {
+        if ( m_size < m_capacity )
+          std::memcpy(m_out+m_size, data, std::min(n, m_capacity-m_size));
+        m_size += n;
+      }
+      /// Number of bytes written so far, including dropped ones
+      size_t size() const { return m_size; };
+    private:
+      char* const m_out;
+      const size_t m_capacity;
+      size_t m_size;
+  };
+
+
+  /**
+   * Write to a std::ostream (straight into its buffer, no temporary
+   * strings)
+   */
+  class StreamSink {
+    public:
+      explicit StreamSink( std::ostream& out ) : m_out(out) {};
+      void write( const char* data, size_t n ) { m_out.write(data, n); }
+    private:
+      std::ostream& m_out;
+  };
+
+
+  /**
+   * Only count bytes
+   */
+  class CountingSink {
+    public:
+      CountingSink() : m_size(0) {};
+      void write( const char*, size_t n ) { m_size += n; }
+      size_t size() const { return m_size; };
+    private:
+      size_t m_size;
+  };
+
+
+  /**
+   * Formats plot elements into a sink without allocating
+   *
+   * Numbers are printed like std::ostream's operator<< does, decorated
+   * strings use TextDecorator's escape codes, and padded fields count
+   * the escape codes of a separately decorated element towards the
+   * field width (as std::setw on TD.green(x) does), so the layout is
+   * the same as that of streaming TD.green(x) etc.
+   *
+   * Escape codes are only written when the style changes: consecutive
+   * elements of the same style share one escape sequence. All styles
+   * are foreground colors, so blanks (which do not show them) do not
+   * end a style run, and a new color is set without resetting the
+   * previous one; any other undecorated byte, e.g. a line break, ends
+   * the run with a reset.
+   */
+  template <typename Sink>
+  class SparklineWriter {
+    public:
+      /// Element styles
+      enum Style
+      {
+        Plain,
+        Box,   // GREEN()
+        Bars,  // BLUE()
+        Shade  // Shade+k: step k of the bar gradient
+      };
+
+      /// Pre-encoded cell contents
+      struct Glyph {
+        char bytes[8];
+        size_t length;
+      };
+
+      /// Constructor
+      SparklineWriter( Sink& sink,
+                       bool print_colored )
+        : m_sink(sink),
+          m_colored(print_colored),
+          m_current(Plain),
+          m_gradient(Solid),
+          m_levels(0)
+      {};
+
+      /**
+       * Color bars by their height instead of BLUE()
+       *
+       * @param gradient The colors
+       * @param levels The highest bar height (in ticks) of the plot
+       */
+      void setGradient( Gradient gradient,
+                        unsigned int levels )
+      {
+        m_gradient = gradient;
+        m_levels   = levels;
+      }
+
+      /// Undecorated bytes
+      void raw( const char* data, size_t n )
+      {
+        if ( m_current != Plain and not _Blank(data, n) )
+          _switch(Plain);
+        m_sink.write(data, n);
+      }
+      void raw( const std::string& s ) { raw(s.data(), s.size()); }
+      void raw( char c ) { raw(&c, 1); }
+
+      /// "n" blanks
+      void spaces( size_t n )
+      {
+        static const char blanks[] = "                                ";
+        while ( n > 0 ) {
+          const size_t chunk = std::min(n, sizeof(blanks)-1);
+          m_sink.write(blanks, chunk);
+          n -= chunk;
+        }
+      }
+
+      /// A blank, left-aligned in a field of "width" characters (like
+      /// "std::setw(width) << ' '", including its conversion to int)
+      void blankField( size_t width )
+      {
+        const int n = (int)width;
+        spaces(n > 1 ? n : 1);
+      }
+
+      /// Decorated string ("style" is a Style, or Shade+k)
+      void styled( unsigned int style, const char* data, size_t n )
+      {
+        _switch(style);
+        m_sink.write(data, n);
+      }
+      void styled( unsigned int style, const std::string& s )
+      {
+        styled(style, s.data(), s.size());
+      }
+
+      /**
+       * Decorated number, left-aligned in a field of "width" bytes
+       * (escape codes of a separately decorated number included)
+       */
+      template <typename U>
+      void number( unsigned int style, U value, size_t width=0 )
+      {
+        char buffer[64];
+        const size_t n = Format(buffer, sizeof(buffer), value);
+        styled(style, buffer, n);
+        spaces(padding(style, n, width));
+      }
+
+      /**
+       * Blanks that follow a decorated number of "n" bytes in a field
+       * of "width" bytes, see number()
+       */
+      size_t padding( unsigned int style, size_t n, size_t width ) const
+      {
+        const Decoration& d = _decoration(style);
+        const size_t length = d.prefix_length + n + d.suffix_length;
+        return width > length ? width-length : 0;
+      }
+
+      /// The style of a bar of "height" ticks: BLUE(), or its step of
+      /// the gradient
+      unsigned int barStyle( unsigned int height ) const
+      {
+        return m_gradient == Solid ? (unsigned int)Bars
+                                   : Shade + _shade(height);
+      }
+
+      /// Cell codes for cell(): BLANK, or 1+tick level (FULL = solid)
+      static const unsigned int BLANK = 0;
+      static const unsigned int FULL  = TICKS;
+
+      /**
+       * One plot cell
+       *
+       * @param code BLANK, or 1 + the tick level (up to FULL)
+       * @param height Height of the cell's bar in ticks (picks the
+       *        color if a gradient is set)
+       */
+      void cell( unsigned int code,
+                 unsigned int height=0 )
+      {
+        const Glyph& glyph = _Glyphs()[code];
+        if ( code != BLANK )
+          _switch(barStyle(height));
+        m_sink.write(glyph.bytes, glyph.length);
+      }
+
+      /**
+       * One Braille character
+       *
+       * @param mask Dot pattern (bit k = dot k+1 of U+2800); 0 is a
+       *        blank
+       * @param height Height of the character's bar in levels (picks
+       *        the color if a gradient is set)
+       */
+      void braille( unsigned int mask,
+                    unsigned int height=0 )
+      {
+        const Glyph& glyph = _BrailleGlyphs()[mask];
+        if ( mask != 0 )
+          _switch(barStyle(height));
+        m_sink.write(glyph.bytes, glyph.length);
+      }
+
+      /// End of a line of cells (the style run is closed by whatever
+      /// follows in a different style)
+      void endCells() {}
+
+      /// Close the current style run; call when done writing
+      void close() { _switch(Plain); }
+
+      /// The glyph that cell() writes for "code"
+      static const Glyph& CellGlyph( unsigned int code )
+      {
+        return _Glyphs()[code];
+      }
+
+      /// The glyph that braille() writes for "mask"
+      static const Glyph& BrailleGlyph( unsigned int mask )
+      {
+        return _BrailleGlyphs()[mask];
+      }
+
+      /// Print numbers like std::ostream's operator<< (default flags)
+      static size_t Format( char* buffer, size_t size, double value )
+      {
+        return std::snprintf(buffer, size, "%g", value);
+      }
+      static size_t Format( char* buffer, size_t size, float value )
+      {
+        return Format(buffer, size, (double)value);
+      }
+      static size_t Format( char* buffer, size_t size, long long value )
+      {
+        return std::snprintf(buffer, size, "%lld", value);
+      }
+      static size_t Format( char* buffer, size_t size,
+                            unsigned long long value )
+      {
+        return std::snprintf(buffer, size, "%llu", value);
+      }
+      static size_t Format( char* buffer, size_t size, int v )
+      { return Format(buffer, size, (long long)v); }
+      static size_t Format( char* buffer, size_t size, long v )
+      { return Format(buffer, size, (long long)v); }
+      static size_t Format( char* buffer, size_t size, short v )
+      { return Format(buffer, size, (long long)v); }
+      static size_t Format( char* buffer, size_t size, unsigned int v )
+      { return Format(buffer, size, (unsigned long long)v); }
+      static size_t Format( char* buffer, size_t size, unsigned long v )
+      { return Format(buffer, size, (unsigned long long)v); }
+      static size_t Format( char* buffer, size_t size, unsigned short v )
+      { return Format(buffer, size, (unsigned long long)v); }
+
+    private:
+      /// Write the escape codes to get from the current style to "style"
+      void _switch( unsigned int style )
+      {
+        if ( style == m_current or not m_colored )
+          return;
+        /// All styles only set the foreground color, so one replaces
+        /// another without a reset in between
+        const Decoration& from = _decoration(m_current);
+        const Decoration& to   = _decoration(style);
+        if ( style == Plain )
+          m_sink.write(from.suffix, from.suffix_length);
+        m_sink.write(to.prefix, to.prefix_length);
+        m_current = style;
       }
-    }
-
-    /// If the plot could spill over the terminal boundaries,
-    /// then limit its width
-    float w_scale = 1.f;
-    {
-      size_t max_width = (size_t)SparklineHelpers::TerminalWidth();
-      if ( enclose_in_box ) 
-        max_width -= ENCLOSURE_WIDTH;
 
-      if ( this_many_characters_wide == 0 )
-        this_many_characters_wide = number_of_data_points;
+      /// Gradient step of a bar height (rounded, lowest bar = step 0)
+      unsigned int _shade( unsigned int height ) const
+      {
+        if ( m_levels <= 1 )
+          return 0;
+        height = std::max(1u, std::min(height, m_levels));
+        const unsigned int steps = _ShadeSteps(m_gradient);
+        return ((height-1)*(steps-1)*2 + m_levels-1) / (2*(m_levels-1));
+      }
 
-      if ( max_width < this_many_characters_wide )
-        this_many_characters_wide = max_width;
+      /// Number of distinct colors of a gradient
+      static unsigned int _ShadeSteps( Gradient gradient )
+      {
+        /// The 256-color palette has 11 entries from green over yellow
+        /// to red; 24-bit colors are smooth enough at 32 steps
+        return gradient == Palette256 ? 11 : 32;
+      }
 
-      w_scale = (float)this_many_characters_wide/number_of_data_points;
-    }
+      /// TRUE if "data" only contains blanks
+      static bool _Blank( const char* data, size_t n )
+      {
+        for ( size_t i = 0; i < n; ++i )
+          if ( data[i] != ' ' )
+            return false;
+        return true;
+      }
 
-    /// TODO 
-    if ( this_many_characters_wide > number_of_data_points ) {
-      throw std::runtime_error("Woops! Not implemented..");
-    }
+      /// Table of cell glyphs, indexed by cell code (built once)
+      static const Glyph* _Glyphs()
+      {
+        struct Table {
+          Glyph glyphs[TICKS+1];
+          Table()
+          {
+            glyphs[BLANK].bytes[0] = ' ';
+            glyphs[BLANK].length = 1;
+            for ( size_t k = 0; k < TICKS; ++k ) {
+              std::memcpy(glyphs[k+1].bytes, ticks[k].data(), ticks[k].size());
+              glyphs[k+1].length = ticks[k].size();
+            }
+          }
+        };
+        static const Table table;
+        return table.glyphs;
+      }
 
-    /// Interpolate data points
-    T bins[this_many_characters_wide];
-    {
-      float bin_slices_indices[this_many_characters_wide+1];
-      for ( size_t i = 0; i <= this_many_characters_wide; ++i ) {
-        bin_slices_indices[i] = i/w_scale;
+      /// UTF-8 encoded Braille characters, indexed by dot pattern
+      /// (built once); pattern 0 is a blank
+      static const Glyph* _BrailleGlyphs()
+      {
+        struct Table {
+          Glyph glyphs[256];
+          Table()
+          {
+            glyphs[0].bytes[0] = ' ';
+            glyphs[0].length = 1;
+            /// U+2800+mask = 0xe2 0xa0+(mask>>6) 0x80+(mask&0x3f)
+            for ( unsigned int mask = 1; mask < 256; ++mask ) {
+              glyphs[mask].bytes[0] = (char)0xe2;
+              glyphs[mask].bytes[1] = (char)(0xa0 | (mask >> 6));
+              glyphs[mask].bytes[2] = (char)(0x80 | (mask & 0x3f));
+              glyphs[mask].length = 3;
+            }
+          }
+        };
+        static const Table table;
+        return table.glyphs;
       }
 
-      const float mass_per_bin = 1/w_scale;
+      /// Escape codes around decorated elements (static strings)
+      struct Decoration {
+        const char* prefix;
+        size_t prefix_length;
+        const char* suffix;
+        size_t suffix_length;
+      };
 
-      for ( size_t i = 0; i < this_many_characters_wide; ++i ) {
-        bins[i] = 0;
+      const Decoration& _decoration( unsigned int style ) const
+      {
+        static const Decoration none = { "", 0, "", 0 };
+        if ( not m_colored or style == Plain )
+          return none;
+        #ifdef WITH_TEXTDECORATOR
+          if ( style >= Shade )
+            return _Shades(m_gradient)[style-Shade];
+          static const Decoration box  = _MakeDecoration(TextDecorator::Green);
+          static const Decoration bars = _MakeDecoration(TextDecorator::Blue);
+          return (style == Box) ? box : bars;
+        #else
+          return none;
+        #endif
+      }
 
-        const float lower = bin_slices_indices[i];
-        const float upper = bin_slices_indices[i+1];
-        bins[i] += (1.f-(lower-(size_t)lower)) * data[(size_t)lower];
-        for (size_t j = (size_t)lower+1; j < (size_t)upper; ++j) {
-          bins[i] += data[j];
-        }
-        if ((size_t)upper < number_of_data_points) {
-          bins[i] += (upper-(size_t)upper) * data[(size_t)upper];
-        }
+      #ifdef WITH_TEXTDECORATOR
+      static Decoration _MakeDecoration( unsigned int format )
+      {
+        const TextDecorator::TextDecorator TD(true);
+        const TextDecorator::Manipulator on  = TD.style(format);
+        const TextDecorator::Manipulator off = TD.reset();
+        const Decoration d = { on.data(), on.size(), off.data(), off.size() };
+        return d;
+      }
 
-        bins[i] /= mass_per_bin;
+      /// Escape codes of a gradient, indexed by step (built once)
+      static const Decoration* _Shades( Gradient gradient )
+      {
+        struct Table {
+          char codes[32][TextDecorator::TextDecorator::MAX_PREFIX_LENGTH];
+          Decoration shades[32];
+          explicit Table( Gradient gradient )
+          {
+            const TextDecorator::TextDecorator TD(true);
+            const TextDecorator::Manipulator off = TD.reset();
+            const unsigned int steps = _ShadeSteps(gradient);
+            for ( unsigned int k = 0; k < steps; ++k ) {
+              /// Green -> yellow -> red
+              size_t length;
+              if ( gradient == Palette256 ) {
+                /// Along the edges of the 6x6x6 color cube
+                const unsigned int r = std::min(k, 5u);
+                const unsigned int g = std::min(10-k, 5u);
+                length = TD.color256(16 + 36*r + 6*g, codes[k]);
+              } else {
+                const double t = (double)k/(steps-1);
+                length = TD.truecolor(std::min(1., 2*t)*255 + .5,
+                                      std::min(1., 2-2*t)*255 + .5,
+                                      0, codes[k]);
+              }
+              shades[k].prefix        = codes[k];
+              shades[k].prefix_length = length;
+              shades[k].suffix        = off.data();
+              shades[k].suffix_length = off.size();
+            }
+          }
+        };
+        static const Table palette(Palette256);
+        static const Table truecolor(TrueColor);
+        return (gradient == Palette256 ? palette : truecolor).shades;
       }
+      #endif
+
+      Sink& m_sink;
+      const bool m_colored;
+      unsigned int m_current;
+      Gradient m_gradient;
+      unsigned int m_levels;
+  };
+
+
+
+  /**
+   * The writer that formats plot elements for a sink; a sink that
+   * keeps the elements themselves rather than bytes (see
+   * LivePlot::FrameCells) specializes this with a writer of its own
+   * that has the interface of SparklineWriter
+   */
+  template <typename Sink>
+  struct WriterFor
+  {
+    typedef SparklineWriter<Sink> type;
+  };
+
+
+  /**
+   * Scratch bytes that SparklineFromBins() takes from its workspace
+   * (x-axis tick marks; there are never more than one per column+1)
+   */
+  inline size_t SparklineFromBinsBytes( size_t number_of_bins )
+  {
+    return 2*SparklineWorkspace::Bytes<size_t>(number_of_bins+1);
+  }
+
+
+  /**
+   * Render a quantized sparkline into a sink
+   *
+   * The quantized form can be kept and re-emitted, e.g. with another
+   * Configuration (colors, box, title); its height overrides the
+   * configured one. No memory is allocated (apart from what the sink
+   * does and the first use of the workspace).
+   *
+   * @param sink Receives the output, see StringSink etc.
+   * @param quantized The plot, see QuantizedSparkline::quantize()
+   * @param number_of_data_points The number of data points that went
+   *        into the plot (for the x-axis labels)
+   * @param config Sparkline::Configuration object; the width, height
+   *        and the min/max values are ignored
+   * @param minv Lower end of the plot range (for the labels)
+   * @param maxv Upper end of the plot range (for the labels)
+   * @param workspace Optional scratch memory in which the caller has
+   *        already reserved SparklineFromBinsBytes(quantized.width())
+   *        bytes (default: DefaultWorkspace())
+   */
+  template <typename T, typename Sink>
+  void SparklineFromQuantizedTo( Sink& sink,
+                                 const QuantizedSparkline& quantized,
+                                 size_t number_of_data_points,
+                                 const Configuration<T>& config,
+                                 T minv,
+                                 T maxv,
+                                 SparklineWorkspace* workspace=0
+                               )
+  {
+    if ( not workspace ) {
+      workspace = &DefaultWorkspace();
+      workspace->begin(SparklineFromBinsBytes(quantized.width()));
     }
-         
 
-    #ifdef WITH_TEXTDECORATOR
-      TextDecorator::TextDecorator TD(print_colored);
-    #endif
+    const bool braille = (quantized.levelsPerLine() == 4 and
+                          DrawsBraille(config.rendering));
+    const size_t this_many_lines_high      = quantized.lines();
+    const size_t this_many_characters_wide = braille
+                                             ? (quantized.width()+1)/2
+                                             : quantized.width();
+    const bool enclose_in_box              = config.enclose_in_box;
+    const std::string& title               = config.title;
 
-    /// Assemble the output in a stringstream
-    std::ostringstream oss;
+    typedef typename WriterFor<Sink>::type Writer;
+    Writer out(sink, config.print_colored);
+    out.setGradient(config.gradient,
+                    this_many_lines_high*quantized.levelsPerLine());
 
     /// Begin box (upper border)
     if ( enclose_in_box ) {
       if ( title.compare("") == 0 ) {
-        oss << GREEN(BOX_NW_CORNER);
+        out.styled(Writer::Box, BOX_NW_CORNER);
         for ( size_t i = 0; i < this_many_characters_wide; ++i )
-          oss << GREEN(BOX_H_BORDER);
-        oss << GREEN(BOX_NE_CORNER) << '\n';
+          out.styled(Writer::Box, BOX_H_BORDER);
+        out.styled(Writer::Box, BOX_NE_CORNER);
+        out.raw('\n');
       } else if ( title.size() > this_many_characters_wide ) {
-        oss << GREEN(title) << '\n';
+        out.styled(Writer::Box, title);
+        out.raw('\n');
       } else {
         size_t filler = this_many_characters_wide-title.size();
-        oss << GREEN(BOX_NW_CORNER);
+        out.styled(Writer::Box, BOX_NW_CORNER);
         size_t i = 0;
         /// Ticks left of the title
         while ( i < filler/2 ) {
-          oss << GREEN(BOX_H_BORDER);
+          out.styled(Writer::Box, BOX_H_BORDER);
           ++i;
         }
-        oss << GREEN(title);
+        out.styled(Writer::Box, title);
         /// Skip ticks covered by title
         i += title.length();
         /// Ticks right of the title
         while ( i < this_many_characters_wide ) {
-          oss << GREEN(BOX_H_BORDER);
+          out.styled(Writer::Box, BOX_H_BORDER);
           ++i;
         }
-        oss << GREEN(BOX_NE_CORNER) << '\n';
+        out.styled(Writer::Box, BOX_NE_CORNER);
+        out.raw('\n');
       }
     }
 
 
-    /// A higher line count means we can display the data more
-    /// finely grained!
-    size_t levels = this_many_lines_high*TICKS-1;
     /// Stretch plot over multiple lines if requested
     for ( int line = (int)this_many_lines_high-1; line >= 0; --line ) {
-      int this_line_min_index = line*TICKS;
-      int this_line_max_index = this_line_min_index+(TICKS-1);
-
       /// Left box border
       if ( enclose_in_box )
-        oss << GREEN(BOX_V_BORDER);
+        out.styled(Writer::Box, BOX_V_BORDER);
 
-      /// Go through all data points
-      for ( size_t i = 0; i < this_many_characters_wide; ++i ) {
-        const T _data = std::min(maxv, std::max(minv, bins[i]));
-        float fraction = (float)(_data-minv)/(float)(maxv-minv);
-        int index = std::floor(fraction*levels);
-        if ( index < this_line_min_index ) {
-          /// Current cell is above the data line -> empty
-          oss << ' '; 
-        } else if ( index > this_line_max_index ) {
-          /// Current cell is below the data line -> solid
-          oss << BLUE(ticks[TICKS-1]);
-        } else {
-          oss << BLUE(ticks[index-this_line_min_index]);
-        }
-      }
+      if ( braille )
+        quantized.emitBrailleLine(out, line);
+      else
+        quantized.emitLine(out, line);
 
       /// Right box border and min/max value marks
       if ( enclose_in_box ) {
-        if ( this_many_lines_high == 1 )
-          oss << GREEN(BOX_V_BORDER_TICK) 
-              << GREEN(" min: ")
-              << std::left << std::setw(PREC) << GREEN(minv) 
-              << GREEN(", max: ") 
-              << std::left << std::setw(PREC) << GREEN(maxv);
-        else if ( line == (int)this_many_lines_high-1 )
-          oss << GREEN(BOX_V_BORDER_TICK) << GREEN(" max: ") << GREEN(maxv);
-        else if ( line == 0 )
-          oss << GREEN(BOX_V_BORDER_TICK) << GREEN(" min: ") << GREEN(minv);
-        else
+        out.styled(Writer::Box, BOX_V_BORDER_TICK);
+        if ( this_many_lines_high == 1 ) {
+          out.styled(Writer::Box, " min: ", 6);
+          out.number(Writer::Box, minv, PREC);
+          out.styled(Writer::Box, ", max: ", 7);
+          out.number(Writer::Box, maxv, PREC);
+        } else if ( line == (int)this_many_lines_high-1 ) {
+          out.styled(Writer::Box, " max: ", 6);
+          out.number(Writer::Box, maxv);
+        } else if ( line == 0 ) {
+          out.styled(Writer::Box, " min: ", 6);
+          out.number(Writer::Box, minv);
+        } else {
           /// Show "middle" level of this line
-          oss << GREEN(BOX_V_BORDER_TICK) << GREEN("      ") 
-              << GREEN((line*TICKS+4) * 
-                  (maxv-minv)/(this_many_lines_high*TICKS) + minv);
-          //oss << GREEN(BOX_V_BORDER);
+          out.styled(Writer::Box, "      ", 6);
+          out.number(Writer::Box, (line*TICKS+4) *
+                       (maxv-minv)/(this_many_lines_high*TICKS) + minv);
+        }
       }
 
       if ( line > 0 )
-        oss << '\n';
+        out.raw('\n');
+    }
+
+    /// Finish box without sample index marks
+    if ( enclose_in_box and not config.show_x_axis ) {
+      out.raw('\n');
+      out.styled(Writer::Box, BOX_SW_CORNER);
+      for ( size_t i = 0; i < this_many_characters_wide; ++i )
+        out.styled(Writer::Box, BOX_H_BORDER);
+      out.styled(Writer::Box, BOX_SE_CORNER);
+      out.raw('\n');
     }
 
     /// Finish box (lower border and sample index marks)
-    if ( enclose_in_box ) {
-      /// Compute tick marks positions
+    if ( enclose_in_box and config.show_x_axis ) {
+      /// Compute tick marks positions; labels are absolute indices
       const size_t sep = 2;
-      const size_t x_ticks_separation = 2*sep + std::ceil(log10(number_of_data_points+1));
+      const size_t last_index = config.x_offset+number_of_data_points;
+      const size_t x_ticks_separation = 2*sep + std::ceil(log10(last_index+1));
       const size_t x_ticks_number = this_many_characters_wide / x_ticks_separation + 1;
-      size_t x_ticks[x_ticks_number];
-      size_t x_ticks_values[x_ticks_number];
+      size_t* const x_ticks        = workspace->take<size_t>(x_ticks_number);
+      size_t* const x_ticks_values = workspace->take<size_t>(x_ticks_number);
       for ( size_t i = 0; i < x_ticks_number-1; ++i ) {
         x_ticks[i]        = i*x_ticks_separation;
-        x_ticks_values[i] = i*number_of_data_points/x_ticks_number;
+        x_ticks_values[i] = config.x_offset +
+                            i*number_of_data_points/x_ticks_number;
       }
       x_ticks[x_ticks_number-1]        = this_many_characters_wide-1;
-      x_ticks_values[x_ticks_number-1] = number_of_data_points;
+      x_ticks_values[x_ticks_number-1] = last_index;
 
       size_t next_tick = 0;
-      oss << '\n';
+      out.raw('\n');
 
-      oss << GREEN(BOX_SW_CORNER);
+      out.styled(Writer::Box, BOX_SW_CORNER);
       for ( size_t i = 0; i < this_many_characters_wide; ++i )
         if ( i == x_ticks[next_tick] ) {
-          oss << GREEN(BOX_H_BORDER_TICK);
+          out.styled(Writer::Box, BOX_H_BORDER_TICK);
           ++next_tick;
         } else {
-          oss << GREEN(BOX_H_BORDER);
+          out.styled(Writer::Box, BOX_H_BORDER);
         }
-      oss << GREEN(BOX_SE_CORNER);
+      out.styled(Writer::Box, BOX_SE_CORNER);
 
 
       /// X-ticks values
       {
-        oss << "\n " << GREEN(x_ticks_values[0]);
+        out.raw("\n ", 2);
+        out.number(Writer::Box, x_ticks_values[0]);
 
         /// Keep track of the line length
         size_t current_col = 1;
@@ -498,47 +2195,259 @@ namespace Sparkline {
 
           /// The remaining sepration space is filled with blanks
           size_t tofill = x_ticks_separation - rw - lw;
-          oss << std::setw(tofill) << std::setfill(' ') << ' ';
-          oss << GREEN(x_ticks_values[i]);
+          out.blankField(tofill);
+          out.number(Writer::Box, x_ticks_values[i]);
 
           current_col += tofill;
         }
 
-        oss << std::setw(x_ticks[x_ticks_number-1]
-               - current_col
-               - SparklineHelpers::CharLength(number_of_data_points)+2)
-            << ' ';
-        oss << GREEN(x_ticks_values[x_ticks_number-1]) 
-            << std::endl;
+        out.blankField(x_ticks[x_ticks_number-1]
+                       - current_col
+                       - SparklineHelpers::CharLength(last_index)+2);
+        out.number(Writer::Box, x_ticks_values[x_ticks_number-1]);
+        out.raw('\n');
       }
     }
 
-    return oss.str();
+    out.close();
   };
-  /// Yes C++, double CAN be used as float...
-  std::string Sparkline( const float* const data,
+
+
+  /**
+   * Render a sparkline from already binned data into a sink
+   *
+   * This is the rendering stage of Sparkline(); the binning stage can
+   * be replaced, e.g. by a StreamingSparkline. The bins are quantized
+   * into the workspace's QuantizedSparkline, which is then emitted by
+   * SparklineFromQuantizedTo().
+   *
+   * @param sink Receives the output, see StringSink etc.
+   * @param bins One value per plot column (see BinCount(); two per
+   *        character for Braille)
+   * @param number_of_bins The number of entries in "bins"
+   * @param number_of_data_points The number of data points that went
+   *        into "bins" (for the x-axis labels)
+   * @param config Sparkline::Configuration object; the width and the
+   *        min/max values are ignored
+   * @param minv Lower end of the plot range
+   * @param maxv Upper end of the plot range
+   * @param lower_bins Optional lower end of every column; if given,
+   *        each column is drawn as a bar from "lower_bins" up to "bins"
+   * @param workspace Optional scratch memory in which the caller has
+   *        already reserved SparklineFromBinsBytes(number_of_bins)
+   *        bytes (default: DefaultWorkspace())
+   */
+  template <typename T, typename Sink>
+  void SparklineFromBinsTo( Sink& sink,
+                            const T* const bins,
+                            size_t number_of_bins,
+                            size_t number_of_data_points,
+                            const Configuration<T>& config,
+                            T minv,
+                            T maxv,
+                            const T* const lower_bins=0,
+                            SparklineWorkspace* workspace=0
+                          )
+  {
+    if ( not workspace ) {
+      workspace = &DefaultWorkspace();
+      workspace->begin(SparklineFromBinsBytes(number_of_bins));
+    }
+
+    QuantizedSparkline& quantized = workspace->quantized();
+    quantized.quantize(bins, number_of_bins, minv, maxv,
+                       config.this_many_lines_high, lower_bins,
+                       LevelsPerLine(config.rendering));
+    SparklineFromQuantizedTo(sink, quantized, number_of_data_points,
+                             config, minv, maxv, workspace);
+  };
+
+
+  /**
+   * Generate sparkline from already binned data
+   *
+   * See SparklineFromBinsTo() for the parameters.
+   *
+   * @returns A std::string containing the sparkline
+   */
+  template <typename T>
+  std::string SparklineFromBins( const T* const bins,
+                                 size_t number_of_bins,
+                                 size_t number_of_data_points,
+                                 const Configuration<T>& config,
+                                 T minv,
+                                 T maxv,
+                                 const T* const lower_bins=0,
+                                 SparklineWorkspace* workspace=0
+                               )
+  {
+    std::string result;
+    StringSink sink(result);
+    SparklineFromBinsTo(sink, bins, number_of_bins, number_of_data_points,
+                        config, minv, maxv, lower_bins, workspace);
+    return result;
+  };
+
+
+  /**
+   * Render a sparkline from data into a sink; with a workspace that is
+   * kept across calls (and a sink that does not allocate), this does
+   * not allocate any memory
+   *
+   * @param sink Receives the output, see StringSink etc.
+   * @param data Input data as array
+   * @param number_of_data_points The number of entries in "data"
+   * @param config Sparkline::Configuration object
+   * @param workspace Scratch memory; keep it across calls to avoid
+   *        allocating the bin arrays every time
+   */
+  template <typename T, typename Sink>
+  void SparklineTo( Sink& sink,
+                    const T* const data,
+                    size_t number_of_data_points,
+                    const Configuration<T>& config,
+                    SparklineWorkspace& workspace=DefaultWorkspace()
+                  )
+  {
+    /// If the plot could spill over the terminal boundaries,
+    /// then limit its width
+    const size_t number_of_bins = BinCount(config, number_of_data_points);
+
+    if ( number_of_data_points == 0 ) {
+      throw std::runtime_error("No data to plot");
+    }
+
+    /// Reduce data points to columns; the data range falls out of the
+    /// same pass
+    const size_t w = number_of_bins;
+    workspace.begin(3*SparklineWorkspace::Bytes<T>(w) +
+                    SparklineFromBinsBytes(w));
+    T* const bins     = workspace.take<T>(w);
+    T* const bins_min = workspace.take<T>(w);
+    T* const bins_max = workspace.take<T>(w);
+    const Downsampler<T>& downsampler = config.downsampler
+                              ? *config.downsampler
+                              : BuiltinDownsampler<T>(config.decimation);
+    Downsample(downsampler, data, number_of_data_points,
+               bins, bins_min, bins_max, number_of_bins,
+               config.aggregation, config.threads, config.upsampling);
+    const bool envelope = downsampler.envelope() or
+                          config.aggregation == MinMax;
+
+    /// Use provided min/max values or adapt to data range
+    T minv = std::min(config.minv, std::numeric_limits<T>::max());
+    T maxv = std::max(config.maxv, std::numeric_limits<T>::min());
+    if ( minv == std::numeric_limits<T>::max() and
+         maxv == std::numeric_limits<T>::min() ) {
+      BinsRange(bins, bins_min, bins_max, number_of_bins,
+                envelope ? MinMax : config.aggregation, minv, maxv);
+    }
+
+    SparklineFromBinsTo(sink,
+                        bins,
+                        number_of_bins,
+                        number_of_data_points,
+                        config,
+                        minv,
+                        maxv,
+                        envelope ? bins_min : 0,
+                        &workspace);
+  };
+
+
+  /**
+   * Generate sparkline from data using a Configuration object
+   *
+   * @param data Input data as array
+   * @param number_of_data_points The number of entries in "data"
+   * @param config Sparkline::Configuration object
+   * @param workspace Scratch memory; keep it across calls to avoid
+   *        allocating the bin arrays every time
+   *
+   * @returns A std::string containing the sparkline for "data"
+   */
+  template <typename T>  /*implicit parameter*/
+  std::string Sparkline( const T* const data,
                          size_t number_of_data_points,
-                         size_t this_many_lines_high,
-                         size_t this_many_characters_wide,
-                         bool enclose_in_box,
-                         bool print_colored,
-                         std::string title,
-                         double max,
-                         double min
-                       ) 
+                         const Configuration<T>& config,
+                         SparklineWorkspace& workspace
+                       )
   {
-    return Sparkline( data,
-                      number_of_data_points,
-                      this_many_lines_high,
-                      this_many_characters_wide,
-                      enclose_in_box,
-                      print_colored,
-                      title,
-                      (float)max,
-                      (float)min
-                    );
-  }
-  
+    std::string result;
+    StringSink sink(result);
+    SparklineTo(sink, data, number_of_data_points, config, workspace);
+    return result;
+  };
+
+
+  /**
+   * Append a sparkline to a string; reusing the same string (after
+   * clear()) keeps its capacity, so steady-state rendering does not
+   * allocate
+   *
+   * @param out The sparkline is appended here
+   *
+   * See Sparkline() for the other parameters.
+   */
+  template <typename T>
+  void SparklineAppend( std::string& out,
+                        const T* const data,
+                        size_t number_of_data_points,
+                        const Configuration<T>& config,
+                        SparklineWorkspace& workspace=DefaultWorkspace()
+                      )
+  {
+    StringSink sink(out);
+    SparklineTo(sink, data, number_of_data_points, config, workspace);
+  };
+
+
+  /**
+   * Render a sparkline into a caller-provided buffer (like snprintf)
+   *
+   * @param out Output buffer
+   * @param capacity Size of "out"; at most capacity-1 bytes of the
+   *        sparkline are written, followed by a terminating '\0'
+   *
+   * See Sparkline() for the other parameters.
+   *
+   * @returns The full length of the sparkline (without '\0'); the
+   *          output was truncated iff this is >= "capacity"
+   */
+  template <typename T>
+  size_t SparklineInto( char* out,
+                        size_t capacity,
+                        const T* const data,
+                        size_t number_of_data_points,
+                        const Configuration<T>& config,
+                        SparklineWorkspace& workspace=DefaultWorkspace()
+                      )
+  {
+    BufferSink sink(out, capacity > 0 ? capacity-1 : 0);
+    SparklineTo(sink, data, number_of_data_points, config, workspace);
+    if ( capacity > 0 )
+      out[std::min(sink.size(), capacity-1)] = '\0';
+    return sink.size();
+  };
+
+
+  /**
+   * Compute the length of a sparkline in bytes, e.g. to size the
+   * buffer for SparklineInto()
+   *
+   * See Sparkline() for the parameters.
+   */
+  template <typename T>
+  size_t SparklineSize( const T* const data,
+                        size_t number_of_data_points,
+                        const Configuration<T>& config,
+                        SparklineWorkspace& workspace=DefaultWorkspace()
+                      )
+  {
+    CountingSink sink;
+    SparklineTo(sink, data, number_of_data_points, config, workspace);
+    return sink.size();
+  };
 
 
   /**
@@ -555,18 +2464,77 @@ namespace Sparkline {
                          size_t number_of_data_points,
                          const Configuration<T>& config
                        )
+  {
+    return Sparkline(data, number_of_data_points, config,
+                     DefaultWorkspace());
+  };
+
+
+  /**
+   * Generate sparkline from data and return string representation
+   *
+   * @param data Input data as array
+   * @param number_of_data_points The number of entries in "data"
+   * @param this_many_lines_high Line height of the plot (use higher
+   *        plots to see more details in the data)
+   * @param this_many_characters_wide Character width of the plot; if 
+   *        unspecified, the plot will be as many characters wide as
+   *        there are data points
+   * @param enclose_in_box Iff TRUE, the sparkline plot will be 
+   *        surrounded by a box outline
+   * @param title Optional caption for the plot
+   * @param minv Optional minimum value for plot scaling; if used, also 
+   *        specify maxv!
+   * @param maxv Optional maximum value for plot scaling
+   *
+   * @returns A std::string containing the sparkline for "data"
+   */
+  template <typename T>  /*implicit parameter*/
+  std::string Sparkline( const T* const data,
+                         size_t number_of_data_points,
+                         size_t this_many_lines_high=1,
+                         size_t this_many_characters_wide=0,
+                         bool enclose_in_box=false,
+                         bool print_colored=true,
+                         std::string title="",
+                         T minv=std::numeric_limits<T>::max(),
+                         T maxv=std::numeric_limits<T>::min()
+                       ) 
   {
     return Sparkline( data,
                       number_of_data_points,
-                      config.this_many_lines_high,
-                      config.this_many_characters_wide,
-                      config.enclose_in_box,
-                      config.print_colored,
-                      config.title,
-                      config.minv,
-                      config.maxv 
+                      Configuration<T>(this_many_lines_high,
+                                       this_many_characters_wide,
+                                       enclose_in_box,
+                                       print_colored,
+                                       title,
+                                       minv,
+                                       maxv)
                     );
   };
+  /// Yes C++, double CAN be used as float...
+  inline std::string Sparkline( const float* const data,
+                                size_t number_of_data_points,
+                                size_t this_many_lines_high,
+                                size_t this_many_characters_wide,
+                                bool enclose_in_box,
+                                bool print_colored,
+                                std::string title,
+                                double max,
+                                double min
+                              ) 
+  {
+    return Sparkline( data,
+                      number_of_data_points,
+                      this_many_lines_high,
+                      this_many_characters_wide,
+                      enclose_in_box,
+                      print_colored,
+                      title,
+                      (float)max,
+                      (float)min
+                    );
+  }
 
 
   /**
@@ -607,15 +2575,15 @@ namespace Sparkline {
                       maxv );
   };
   /// Yes C++, double CAN be used as float...
-  std::string Sparkline( const std::vector<float>& data,
-                         size_t this_many_lines_high,
-                         size_t this_many_characters_wide,
-                         bool enclose_in_box,
-                         bool print_colored,
-                         std::string title,
-                         double max,
-                         double min
-                       ) 
+  inline std::string Sparkline( const std::vector<float>& data,
+                                size_t this_many_lines_high,
+                                size_t this_many_characters_wide,
+                                bool enclose_in_box,
+                                bool print_colored,
+                                std::string title,
+                                double max,
+                                double min
+                              ) 
   {
     return Sparkline( data,
                       this_many_lines_high,
@@ -642,24 +2610,265 @@ namespace Sparkline {
                          const Configuration<T>& config
                        )
   {
-    return Sparkline( data,
-                      config.this_many_lines_high,
-                      config.this_many_characters_wide,
-                      config.enclose_in_box,
-                      config.print_colored,
-                      config.title,
-                      config.minv,
-                      config.maxv 
+    /// Forward the whole Configuration so that aggregation, decimation
+    /// and threads are not lost
+    return Sparkline( &data[0],
+                      (size_t)data.size(),
+                      config
                     );
   };
   
 
 
 
+  /// /////////////////////////////////////////////////////////////////
+  /// Streaming sparklines
+  /// /////////////////////////////////////////////////////////////////
+
+  /**
+   * Accumulate a sparkline from a stream of values in O(width) memory
+   *
+   * If the total number of values is known in advance, every value is
+   * added to its (at most two) bins right away, and the result is the
+   * same as that of Sparkline() on the whole data. Otherwise, values
+   * are collected into between "width" and 2*"width" equally large
+   * blocks; whenever all blocks are full, neighbouring blocks are
+   * merged and the block size doubles. render() then combines the
+   * blocks into the plot columns. Values are always area-binned; the
+   * decimation setting of "config" does not apply.
+   *
+   * @param config Sparkline::Configuration object
+   * @param expected_count The exact number of values that will be
+   *        pushed, or 0 if unknown; render() fails if a different
+   *        number of values was pushed
+   */
+  template <typename T>
+  class StreamingSparkline {
+    public:
+      /// Constructor
+      StreamingSparkline( const Configuration<T>& config,
+                          size_t expected_count=0
+                        )
+        : m_config(config),
+          m_expected_count(expected_count),
+          m_count(0),
+          m_current_bin(0),
+          m_block_size(1),
+          m_block_fill(0)
+      {
+        /// An unknown count may be arbitrarily large: take all columns
+        /// the configuration (or the terminal) allows
+        m_width = BinCount(config, expected_count > 0
+                                   ? expected_count
+                                   : std::numeric_limits<unsigned short>::max());
+        if ( m_width == 0 )
+          m_width = 1;
+
+        if ( m_expected_count > 0 ) {
+          /// Bin boundaries exactly as in AreaBinning()
+          const float w_scale = (float)m_width/m_expected_count;
+          m_bin_slices_indices.resize(m_width+1);
+          for ( size_t i = 0; i <= m_width; ++i )
+            m_bin_slices_indices[i] = i/w_scale;
+          m_bins.resize(m_width);
+        } else {
+          m_bins.reserve(2*m_width);
+        }
+      };
+      /// Destructor
+      ~StreamingSparkline() {};
+
+      /**
+       * Add one value
+       *
+       * @param value The next data point
+       */
+      void push( T value )
+      {
+        /// Surplus values are only counted, for render()'s check
+        if ( m_expected_count == 0 )
+          _pushBlock(value);
+        else if ( m_count < m_expected_count )
+          _pushExact(value);
+
+        ++m_count;
+      }
+
+      /**
+       * Add many values
+       *
+       * @param data Input data as array
+       * @param number_of_data_points The number of entries in "data"
+       */
+      void push( const T* const data,
+                 size_t number_of_data_points )
+      {
+        for ( size_t i = 0; i < number_of_data_points; ++i )
+          push(data[i]);
+      }
+
+      /// Container-style interface, e.g. for DataInput::ParseAll()
+      typedef T value_type;
+      void push_back( T value ) { push(value); };
+
+      /// The number of values pushed so far
+      size_t size() const { return m_count; };
+
+      /**
+       * Generate the sparkline of all values pushed so far; throws if
+       * there are none, or if their number is not the expected one
+       *
+       * @returns A std::string containing the sparkline
+       */
+      std::string render() const
+      {
+        if ( m_count == 0 )
+          throw std::runtime_error("No data to plot");
+        if ( m_expected_count > 0 and m_count != m_expected_count ) {
+          std::ostringstream oss;
+          oss << "Expected " << m_expected_count << " values, but got "
+              << (m_count > m_expected_count ? "more" : "only ");
+          if ( m_count < m_expected_count )
+            oss << m_count;
+          throw std::runtime_error(oss.str());
+        }
+
+        const Aggregation aggregation = m_config.aggregation;
+        const size_t width = std::min(m_width, m_expected_count > 0
+                                               ? m_expected_count
+                                               : m_count);
+        SparklineWorkspace& workspace = DefaultWorkspace();
+        workspace.begin(3*SparklineWorkspace::Bytes<T>(width) +
+                        SparklineFromBinsBytes(width));
+        T* const bins     = workspace.take<T>(width);
+        T* const bins_min = workspace.take<T>(width);
+        T* const bins_max = workspace.take<T>(width);
+
+        if ( m_expected_count > 0 ) {
+          const float mass_per_bin = (float)m_expected_count/m_width;
+          for ( size_t i = 0; i < width; ++i ) {
+            bins[i]     = m_bins[i].value(aggregation, mass_per_bin);
+            bins_min[i] = m_bins[i].minv;
+            bins_max[i] = m_bins[i].maxv;
+          }
+        } else {
+          /// Blocks, including the incomplete last one
+          std::vector<BinAccumulator<T> > blocks(m_bins);
+          if ( m_block_fill > 0 )
+            blocks.push_back(m_block);
+
+          /// Column i covers data points [i*step, (i+1)*step); block b
+          /// covers [b*m_block_size, (b+1)*m_block_size)
+          const double step = (double)m_count/width;
+          size_t b = 0;
+          for ( size_t i = 0; i < width; ++i ) {
+            const double lower = i*step;
+            const double upper = (i+1 == width) ? m_count : (i+1)*step;
+            BinAccumulator<T> column;
+            double mass = 0.;
+            while ( b < blocks.size() ) {
+              const double block_lower = (double)b*m_block_size;
+              const double block_upper = std::min((double)(b+1)*m_block_size,
+                                                  (double)m_count);
+              const double overlap = std::min(upper, block_upper)
+                                     - std::max(lower, block_lower);
+              column.merge(blocks[b],
+                           (float)(overlap/(block_upper-block_lower)));
+              mass += std::max(overlap, 0.);
+              /// The block reaches into the next column
+              if ( block_upper > upper )
+                break;
+              ++b;
+            }
+            bins[i]     = column.value(aggregation, (float)mass);
+            bins_min[i] = column.minv;
+            bins_max[i] = column.maxv;
+          }
+        }
+
+        T minv = std::min(m_config.minv, std::numeric_limits<T>::max());
+        T maxv = std::max(m_config.maxv, std::numeric_limits<T>::min());
+        if ( minv == std::numeric_limits<T>::max() and
+             maxv == std::numeric_limits<T>::min() )
+          BinsRange(bins, bins_min, bins_max, width,
+                    aggregation, minv, maxv);
+
+        return SparklineFromBins(bins,
+                                 width,
+                                 m_expected_count > 0 ? m_expected_count
+                                                      : m_count,
+                                 m_config,
+                                 minv,
+                                 maxv,
+                                 aggregation == MinMax ? bins_min : 0,
+                                 &workspace);
+      }
+
+    private:
+      /// Known total count: add "value" to its bin(s) directly
+      void _pushExact( T value )
+      {
+        const size_t j = m_count;
+        while ( m_current_bin < m_width ) {
+          const float lower = m_bin_slices_indices[m_current_bin];
+          const float upper = m_bin_slices_indices[m_current_bin+1];
+          BinAccumulator<T>& bin = m_bins[m_current_bin];
+          if ( j == (size_t)lower )
+            bin.add(value, 1.f-(lower-(size_t)lower));
+          else if ( j < (size_t)upper )
+            bin.add(value);
+          /// A value on the upper boundary is shared with the next bin
+          if ( j == (size_t)upper ) {
+            bin.add(value, upper-(size_t)upper);
+            ++m_current_bin;
+            continue;
+          }
+          break;
+        }
+      }
+
+      /// Unknown total count: collect into blocks of doubling size
+      void _pushBlock( T value )
+      {
+        m_block.add(value);
+        if ( ++m_block_fill < m_block_size )
+          return;
+
+        m_bins.push_back(m_block);
+        m_block = BinAccumulator<T>();
+        m_block_fill = 0;
+        if ( m_bins.size() == 2*m_width ) {
+          for ( size_t i = 0; i < m_width; ++i ) {
+            m_bins[i] = m_bins[2*i];
+            m_bins[i].merge(m_bins[2*i+1]);
+          }
+          m_bins.resize(m_width);
+          m_block_size *= 2;
+        }
+      }
+
+      const Configuration<T> m_config;
+      const size_t m_expected_count;
+      size_t m_width;
+      size_t m_count;
+      /// Known count: one accumulator per bin, and the bin boundaries;
+      /// unknown count: one accumulator per complete block
+      std::vector<BinAccumulator<T> > m_bins;
+      std::vector<float> m_bin_slices_indices;
+      size_t m_current_bin;
+      /// Unknown count: the block currently being filled
+      size_t m_block_size;
+      size_t m_block_fill;
+      BinAccumulator<T> m_block;
+  };
+
+
+
+
   /**
    * Showcase: Display a normal distribution (Gaussian bell curve)
    */
-  std::string ShowExampleGaussian()
+  inline std::string ShowExampleGaussian()
   {
     std::vector<float> data_vec{
       0.000514092998764,
@@ -699,7 +2908,7 @@ namespace Sparkline {
   /**
    * Showcase: Display a sine wave using various configurations
    */
-  std::string ShowExamples()
+  inline std::string ShowExamples()
   {
     std::ostringstream oss;
     oss << "\n"
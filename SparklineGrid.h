@@ -0,0 +1,335 @@
+/**
+ * ===================================================================
+ *
+ * Author: Nikolaus Mayer, 2018 (mayern@cs.uni-freiburg.de)
+ *
+ * SparklineGrid
+ *
+ * Arrange many small sparklines in a grid that fills the terminal
+ *
+ * ===================================================================
+ *
+ * Usage example:
+ *
+ * >
+ * > #include <vector>
+ * > #include "SparklineGrid.h"
+ * >
+ * > int main(int argc, char** argv)
+ * > {
+ * >   std::vector<std::vector<float> > series(200, std::vector<float>(100));
+ * >   /// ... fill series ...
+ * >
+ * >   Sparkline::Configuration<float> config(2, 16, true);
+ * >   Sparkline::SparklineGrid<float> grid(config);
+ * >   for ( size_t i = 0; i < series.size(); ++i )
+ * >     grid.add(&series[i][0], series[i].size(), "#"+std::to_string(i));
+ * >
+ * >   /// Render all cells concurrently, then write(2) the screen once
+ * >   grid.write(STDOUT_FILENO);
+ * >   return 0;
+ * > }
+ * >
+ *
+ * ===================================================================
+ */
+
+#ifndef SPARKLINEGRID_H__
+#define SPARKLINEGRID_H__
+
+// System/STL
+#include <algorithm>      // std::max
+#include <cerrno>
+#include <cstring>        // std::strerror
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>       // write(), STDOUT_FILENO
+// Local files
+#include "Sparkline.h"
+#include "ThreadPool.h"
+
+
+
+namespace Sparkline {
+
+
+  /// Plot width of grid cells if the configuration does not set one
+  const size_t DEFAULT_GRID_CELL_WIDTH = 20;
+
+
+  /**
+   * Sink that keeps the rendered lines of one grid cell, and the
+   * visible width of every line (escape sequences and UTF-8
+   * continuation bytes take no space)
+   *
+   * The buffers are kept across renders, so a grid that is redrawn
+   * with similar data stops allocating.
+   */
+  class GridSlot {
+    public:
+      /// Constructor
+      GridSlot()
+        : m_in_escape(false)
+      {};
+      /// Destructor
+      ~GridSlot() {};
+
+      /// Forget the previous contents (but keep the memory)
+      void clear()
+      {
+        m_bytes.clear();
+        m_line_ends.clear();
+        m_widths.assign(1, 0);
+        m_in_escape = false;
+      }
+
+      /// Sink interface
+      void write( const char* data,
+                  size_t n )
+      {
+        for ( size_t i = 0; i < n; ++i ) {
+          const unsigned char c = data[i];
+          if ( c == '\n' ) {
+            m_line_ends.push_back(m_bytes.size());
+            m_widths.push_back(0);
+            continue;
+          }
+          m_bytes.push_back((char)c);
+          if ( m_in_escape ) {
+            /// An escape sequence ends with a byte in 0x40..0x7e
+            if ( c >= 0x40 and c <= 0x7e and c != '[' )
+              m_in_escape = false;
+          } else if ( c == '\x1b' ) {
+            m_in_escape = true;
+          } else if ( (c & 0xc0) != 0x80 ) {
+            ++m_widths.back();
+          }
+        }
+      }
+
+      /// Finish the last line; a trailing empty line is dropped
+      void close()
+      {
+        if ( m_widths.back() == 0 and
+             (m_line_ends.empty() or m_line_ends.back() == m_bytes.size()) )
+          m_widths.pop_back();
+        else
+          m_line_ends.push_back(m_bytes.size());
+      }
+
+      /// Number of lines
+      size_t lines() const { return m_widths.size(); };
+      /// Visible width of a line
+      size_t width( size_t line ) const { return m_widths[line]; };
+      /// Bytes of a line
+      const char* line( size_t line ) const
+      {
+        return m_bytes.data() + (line == 0 ? 0 : m_line_ends[line-1]);
+      }
+      /// Number of bytes of a line
+      size_t lineBytes( size_t line ) const
+      {
+        return m_line_ends[line] - (line == 0 ? 0 : m_line_ends[line-1]);
+      }
+
+    private:
+      std::vector<char> m_bytes;
+      std::vector<size_t> m_line_ends;
+      std::vector<size_t> m_widths;
+      bool m_in_escape;
+  };
+
+
+  /**
+   * Small multiples: many sparklines laid out in rows of equally wide
+   * cells
+   *
+   * Every cell is rendered straight into its own slot (no string
+   * concatenation or line splitting), all cells concurrently. The
+   * slots are then copied line by line into one screen buffer, padded
+   * to equal visible widths, which is sent to the terminal with a
+   * single write(2).
+   *
+   * @param config Sparkline::Configuration for every cell; the title
+   *        is replaced by the cell's title, and a width of 0 means
+   *        DEFAULT_GRID_CELL_WIDTH
+   * @param columns Number of cells per row; 0 means as many as fit
+   *        into the terminal
+   * @param gap Number of blank characters between cells
+   */
+  template <typename T>
+  class SparklineGrid {
+    public:
+      /// Constructor
+      SparklineGrid( const Configuration<T>& config,
+                     size_t columns=0,
+                     size_t gap=1
+                   )
+        : m_config(config),
+          m_columns(columns),
+          m_gap(gap),
+          m_threads(0)
+      {
+        if ( m_config.this_many_characters_wide == 0 )
+          m_config.setWidth(DEFAULT_GRID_CELL_WIDTH);
+        /// Cells run concurrently, not the downsampling within a cell
+        m_config.setThreads(1);
+      };
+      /// Destructor
+      ~SparklineGrid() {};
+
+      /**
+       * Add a cell
+       *
+       * @param data Input data as array (not copied; must stay valid
+       *        until the grid is rendered)
+       * @param number_of_data_points The number of entries in "data";
+       *        a cell without data stays blank
+       * @param title Caption of the cell
+       */
+      void add( const T* data,
+                size_t number_of_data_points,
+                const std::string& title="" )
+      {
+        Cell cell;
+        cell.data  = data;
+        cell.size  = number_of_data_points;
+        cell.title = title;
+        m_cells.push_back(cell);
+      }
+
+      /// Remove all cells
+      void clear() { m_cells.clear(); };
+
+      /// Number of cells
+      size_t size() const { return m_cells.size(); };
+
+      /// Maximum number of rendering threads; 0 means one per CPU
+      void setThreads( size_t threads ) { m_threads = threads; };
+
+      /**
+       * Render all cells into the screen buffer
+       *
+       * @returns The screen; valid until the next render()
+       */
+      const std::string& render()
+      {
+        const size_t n = m_cells.size();
+        if ( m_slots.size() < n )
+          m_slots.resize(n);
+
+        /// Render every cell into its slot
+        std::vector<std::string> errors(n);
+        ThreadPool::ParallelFor(n, m_threads, [&](size_t i) {
+          GridSlot& slot = m_slots[i];
+          slot.clear();
+          if ( m_cells[i].size > 0 ) {
+            Configuration<T> cell_config(m_config);
+            cell_config.setTitle(m_cells[i].title);
+            try {
+              SparklineTo(slot, m_cells[i].data, m_cells[i].size,
+                          cell_config);
+            } catch ( const std::runtime_error& e ) {
+              errors[i] = e.what();
+            }
+          }
+          slot.close();
+        });
+        for ( size_t i = 0; i < n; ++i )
+          if ( not errors[i].empty() )
+            throw std::runtime_error(errors[i]);
+
+        /// As many cells per row as fit next to each other
+        size_t widest = 0;
+        for ( size_t i = 0; i < n; ++i )
+          for ( size_t l = 0; l < m_slots[i].lines(); ++l )
+            widest = std::max(widest, m_slots[i].width(l));
+        size_t per_row = m_columns;
+        if ( per_row == 0 )
+          per_row = (SparklineHelpers::TerminalWidth()+m_gap)/(widest+m_gap);
+        per_row = std::max((size_t)1, std::min(per_row, n));
+
+        /// Every grid column is as wide as its widest line
+        m_widths.assign(per_row, 0);
+        for ( size_t i = 0; i < n; ++i )
+          for ( size_t l = 0; l < m_slots[i].lines(); ++l )
+            m_widths[i%per_row] = std::max(m_widths[i%per_row],
+                                           m_slots[i].width(l));
+
+        /// Compose the screen row by row
+        m_screen.clear();
+        for ( size_t first = 0; first < n; first += per_row ) {
+          const size_t last = std::min(first+per_row, n);
+          size_t height = 0;
+          for ( size_t i = first; i < last; ++i )
+            height = std::max(height, m_slots[i].lines());
+          for ( size_t l = 0; l < height; ++l ) {
+            size_t pending = 0;
+            for ( size_t i = first; i < last; ++i ) {
+              const GridSlot& slot = m_slots[i];
+              if ( l < slot.lines() ) {
+                m_screen.append(pending, ' ');
+                m_screen.append(slot.line(l), slot.lineBytes(l));
+                pending = m_widths[i-first] - slot.width(l);
+              } else {
+                pending += m_widths[i-first];
+              }
+              pending += m_gap;
+            }
+            m_screen += '\n';
+          }
+        }
+        return m_screen;
+      }
+
+      /**
+       * Render all cells and write the screen to a file descriptor
+       * with one write(2) call (more only if the descriptor accepts
+       * partial writes, e.g. a full pipe)
+       *
+       * @param fd The file descriptor to write to (not closed)
+       */
+      void write( int fd=STDOUT_FILENO )
+      {
+        render();
+        const char* p = m_screen.data();
+        size_t left = m_screen.size();
+        while ( left > 0 ) {
+          const ssize_t written = ::write(fd, p, left);
+          if ( written < 0 ) {
+            if ( errno == EINTR )
+              continue;
+            throw std::runtime_error(std::string("write() failed: ")
+                                     + std::strerror(errno));
+          }
+          p    += written;
+          left -= (size_t)written;
+        }
+      }
+
+    private:
+      /// One series
+      struct Cell {
+        const T* data;
+        size_t size;
+        std::string title;
+      };
+
+      Configuration<T> m_config;
+      size_t m_columns;
+      size_t m_gap;
+      size_t m_threads;
+      std::vector<Cell> m_cells;
+      std::vector<GridSlot> m_slots;
+      std::vector<size_t> m_widths;
+      std::string m_screen;
+  };
+
+
+}  // namespace Sparkline
+
+
+
+#endif  // SPARKLINEGRID_H__
+
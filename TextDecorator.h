@@ -27,6 +27,9 @@
  * >                                                 TextDecorator::Inverse)
  * >             << '\n';
  * >
+ * >   /// Or switch styles inside a stream, without temporary strings
+ * >   std::cout << TD.style(TextDecorator::Green) << 42 << TD.reset() << '\n';
+ * >
  * >   return 0;
  * > }
  * >
@@ -40,10 +43,13 @@
 #define TEXTDECORATOR_H__
 
 
+#include <cstddef>   // size_t
+#include <cstring>   // std::memcpy, std::strlen
 #include <iostream>
 #include <map>       // std::map
 #include <string>    // std::string
 #include <sstream>   // std::ostringstream
+#include <type_traits>
 
 
 namespace TextDecorator {
@@ -63,6 +69,130 @@ namespace TextDecorator {
   };
 
 
+  /// Number of distinct formatting codes (all combinations of the above)
+  const unsigned int FORMATS = 1<<7;
+
+
+  /// ///////////////////////////////////////////////////////////////////
+  /// Compile-time escape codes
+  /// ///////////////////////////////////////////////////////////////////
+
+  /// SGR parameter of a single formatting option
+  constexpr unsigned int SGRCode( unsigned int SGR )
+  {
+    return SGR == Red       ? 31 :
+           SGR == Green     ? 32 :
+           SGR == Blue      ? 34 :
+           SGR == Black     ? 30 :
+           SGR == Bold      ?  1 :
+           SGR == Underline ?  4 :
+           SGR == Inverse   ?  7 : 0;
+  }
+
+  /// The order in which decorate() emits the options of a format
+  constexpr unsigned int SGROrder( unsigned int i )
+  {
+    return i == 0 ? Red   : i == 1 ? Green     : i == 2 ? Blue    :
+           i == 3 ? Black : i == 4 ? Bold      : i == 5 ? Underline :
+           i == 6 ? Inverse : 0;
+  }
+
+  /// A string as a list of characters, stored once per distinct list
+  template <char... C>
+  struct Chars {
+    static const char value[sizeof...(C)+1];
+    static const size_t length = sizeof...(C);
+  };
+  template <char... C>
+  const char Chars<C...>::value[sizeof...(C)+1] = { C..., '\0' };
+
+  /// Concatenation of Chars lists
+  template <typename... L>
+  struct _Concat;
+  template <char... A>
+  struct _Concat<Chars<A...> > { typedef Chars<A...> type; };
+  template <char... A, char... B, typename... Rest>
+  struct _Concat<Chars<A...>, Chars<B...>, Rest...>
+  {
+    typedef typename _Concat<Chars<A..., B...>, Rest...>::type type;
+  };
+
+  /// Decimal digits of a (one- or two-digit) SGR parameter
+  template <unsigned int Code, bool TwoDigits=(Code >= 10)>
+  struct _Digits { typedef Chars<'0'+Code/10, '0'+Code%10> type; };
+  template <unsigned int Code>
+  struct _Digits<Code, false> { typedef Chars<'0'+Code> type; };
+
+  /// SGR parameters of the options in "Format", starting at SGROrder(I)
+  template <unsigned int Format,
+            unsigned int I,
+            bool Active=((Format & SGROrder(I)) != 0)>
+  struct _SGRList;
+  template <unsigned int I>
+  struct _SGRList<0, I, false> { typedef Chars<> type; };
+  template <unsigned int Format, unsigned int I>
+  struct _SGRList<Format, I, false>
+  {
+    typedef typename _SGRList<Format, I+1>::type type;
+  };
+  template <unsigned int Format, unsigned int I>
+  struct _SGRList<Format, I, true>
+  {
+    static const unsigned int rest = Format & ~SGROrder(I);
+    typedef typename _Concat<
+              typename _Digits<SGRCode(SGROrder(I))>::type,
+              typename std::conditional<rest != 0, Chars<';'>,
+                                                   Chars<> >::type,
+              typename _SGRList<rest, I+1>::type>::type type;
+  };
+
+  /**
+   * The formatting code that decorate() puts in front of its input,
+   * built at compile time; StaticPrefix<Red|Bold>::type::value is
+   * "\x1b[31;1m"
+   */
+  template <unsigned int Format>
+  struct StaticPrefix
+  {
+    static_assert(Format < FORMATS, "Unknown formatting code");
+    typedef typename _Concat<Chars<'\x1b', '['>,
+                             typename _SGRList<Format, 0>::type,
+                             Chars<'m'> >::type type;
+  };
+  template <>
+  struct StaticPrefix<0> { typedef Chars<> type; };
+
+
+  /**
+   * Stream manipulator that writes a formatting code straight into the
+   * stream; see TextDecorator::style() and TextDecorator::reset()
+   */
+  class Manipulator
+  {
+  public:
+    Manipulator( const char* bytes,
+                 size_t length )
+      : m_bytes(bytes),
+        m_length(length)
+    {}
+
+    /// The escape sequence (static storage, not terminated)
+    const char* data() const { return m_bytes; }
+    /// Its length in bytes (0 if there is nothing to write)
+    size_t size() const { return m_length; }
+
+  private:
+    const char* m_bytes;
+    size_t m_length;
+  };
+
+  inline std::ostream& operator<<( std::ostream& os,
+                                   const Manipulator& manipulator )
+  {
+    return os.write(manipulator.data(), manipulator.size());
+  }
+
+
   class TextDecorator
   {
     
@@ -151,6 +281,22 @@ namespace TextDecorator {
                           bool override_action=false
                         )
     {
+      /// Known formats are looked up, not assembled (the debug output
+      /// is only printed by the assembling code)
+      if ( not m_debug and format < FORMATS ) {
+        std::string result;
+        if ( format == 0 or
+             (!m_action and !override_action) ) {
+          _Append(result, input);
+          return result;
+        }
+        const Prefix& prefix = _Prefixes()[format];
+        result.reserve(prefix.length + _Length(input) + 3);
+        result.append(prefix.bytes, prefix.length);
+        _Append(result, input);
+        result.append("\x1b[m", 3);
+        return result;
+      }
 
       if ( m_debug )
         std::cout << "TextDecorator: DEBUG INFORMATION: Codepoint <<"
@@ -261,45 +407,293 @@ namespace TextDecorator {
     }
 
 
+    /**
+     * Decorate a string with a formatting code that is known at compile
+     * time, e.g. decorate<Red|Bold>("text")
+     *
+     * @param input The input. Can be any datatype that can be string-ified
+     * @param override_action Iff TRUE, will do something even is m_action is FALSE
+     *
+     * @returns The "input" string, decorated with leading and trailing formatting code
+     */
+    template <unsigned int Format, typename T>
+    std::string decorate( const T& input,
+                          bool override_action=false
+                        )
+    {
+      typedef typename StaticPrefix<Format>::type Code;
+      if ( m_debug )
+        return decorate(input, Format, override_action);
+
+      std::string result;
+      if ( Format == 0 or
+           (!m_action and !override_action) ) {
+        _Append(result, input);
+        return result;
+      }
+      result.reserve(Code::length + _Length(input) + 3);
+      result.append(Code::value, Code::length);
+      _Append(result, input);
+      result.append("\x1b[m", 3);
+      return result;
+    }
+
+
+    /// Buffer size that is always enough for a formatting code, e.g.
+    /// for color256() and truecolor()
+    static const size_t MAX_PREFIX_LENGTH = 32;
+
+
+    /**
+     * Switch a stream to a format: "os << TD.style(Red|Bold) << value
+     * << TD.reset()" writes the same bytes as "os << TD.decorate(value,
+     * Red|Bold)", but without building a string. Format 0 is the
+     * exception: style(0) writes nothing, but reset() still writes the
+     * reset code, whereas decorate(value, 0) leaves "value" bare.
+     *
+     * @param format The formatting code (unknown bits are ignored)
+     * @param override_action Iff TRUE, will do something even is m_action is FALSE
+     *
+     * @returns A manipulator that writes the formatting code
+     */
+    Manipulator style( unsigned int format,
+                       bool override_action=false
+                     ) const
+    {
+      format &= FORMATS-1;
+      if ( format == 0 or
+           (!m_action and !override_action) )
+        return Manipulator("", 0);
+      const Prefix& prefix = _Prefixes()[format];
+      return Manipulator(prefix.bytes, prefix.length);
+    }
+
+    /// style() for a formatting code that is known at compile time
+    template <unsigned int Format>
+    Manipulator style( bool override_action=false ) const
+    {
+      typedef typename StaticPrefix<Format>::type Code;
+      if ( !m_action and !override_action )
+        return Manipulator("", 0);
+      return Manipulator(Code::value, Code::length);
+    }
+
+    /**
+     * Switch a stream back to unformatted text
+     *
+     * @param override_action Iff TRUE, will do something even is m_action is FALSE
+     *
+     * @returns A manipulator that writes the reset code
+     */
+    Manipulator reset( bool override_action=false ) const
+    {
+      if ( !m_action and !override_action )
+        return Manipulator("", 0);
+      return Manipulator("\x1b[m", 3);
+    }
+
+
+    /**
+     * Write the formatting code for a foreground color from the
+     * 256-color palette ("\x1b[38;5;<index>m"); end it with reset()
+     *
+     * @param index Palette entry (16-231 are a 6x6x6 color cube)
+     * @param out Output buffer with at least MAX_PREFIX_LENGTH bytes
+     * @param override_action Iff TRUE, will do something even is m_action is FALSE
+     *
+     * @returns The number of bytes written to "out" (0 if decorating
+     *          is disabled)
+     */
+    size_t color256( unsigned char index,
+                     char* out,
+                     bool override_action=false
+                   ) const
+    {
+      if ( !m_action and !override_action )
+        return 0;
+      size_t length = _Copy(out, 0, "\x1b[38;5;");
+      length = _AppendDecimal(out, length, index);
+      out[length++] = 'm';
+      return length;
+    }
+
+
+    /**
+     * Write the formatting code for a 24-bit foreground color
+     * ("\x1b[38;2;<r>;<g>;<b>m"); end it with reset()
+     *
+     * @param r Red component
+     * @param g Green component
+     * @param b Blue component
+     * @param out Output buffer with at least MAX_PREFIX_LENGTH bytes
+     * @param override_action Iff TRUE, will do something even is m_action is FALSE
+     *
+     * @returns The number of bytes written to "out" (0 if decorating
+     *          is disabled)
+     */
+    size_t truecolor( unsigned char r,
+                      unsigned char g,
+                      unsigned char b,
+                      char* out,
+                      bool override_action=false
+                    ) const
+    {
+      if ( !m_action and !override_action )
+        return 0;
+      size_t length = _Copy(out, 0, "\x1b[38;2;");
+      length = _AppendDecimal(out, length, r);
+      out[length++] = ';';
+      length = _AppendDecimal(out, length, g);
+      out[length++] = ';';
+      length = _AppendDecimal(out, length, b);
+      out[length++] = 'm';
+      return length;
+    }
 
     
     /** 
      * Predefined styles for warnings / errors 
      */
-    std::string warning() { return decorate("WARNING: ", Red|Bold); }
-    std::string error()   { return decorate("!!!ERROR!!!: ", Red|Bold|Inverse); }
+    std::string warning() { return decorate<Red|Bold>("WARNING: "); }
+    std::string error()   { return decorate<Red|Bold|Inverse>("!!!ERROR!!!: "); }
     
     template <typename T>
-    std::string warning( const T& input ) { return decorate(input, Red|Bold); }
+    std::string warning( const T& input ) { return decorate<Red|Bold>(input); }
     template <typename T>
-    std::string error( const T& input ) { return decorate(input, Red|Bold|Inverse); }
+    std::string error( const T& input ) { return decorate<Red|Bold|Inverse>(input); }
     
     /** 
      * Predefined styles for colors 
      */  
     template <typename T>
-    std::string red( const T& input )   { return decorate(input, Red); }
+    std::string red( const T& input )   { return decorate<Red>(input); }
     template <typename T>
-    std::string green( const T& input ) { return decorate(input, Green); }
+    std::string green( const T& input ) { return decorate<Green>(input); }
     template <typename T>
-    std::string blue( const T& input )  { return decorate(input, Blue); }
+    std::string blue( const T& input )  { return decorate<Blue>(input); }
     template <typename T>
-    std::string black( const T& input ) { return decorate(input, Black); }
+    std::string black( const T& input ) { return decorate<Black>(input); }
 
     /** 
      * Predefined styles for font faces 
      */
     template <typename T>
-    std::string bold( const T& input )      { return decorate(input, Bold); }
+    std::string bold( const T& input )      { return decorate<Bold>(input); }
     template <typename T>
-    std::string underline( const T& input ) { return decorate(input, Underline); }
+    std::string underline( const T& input ) { return decorate<Underline>(input); }
     template <typename T>
-    std::string inverse( const T& input )   { return decorate(input, Inverse); }
+    std::string inverse( const T& input )   { return decorate<Inverse>(input); }
 
 
 
   private:
 
+    /// A pre-built formatting code
+    struct Prefix {
+      char bytes[MAX_PREFIX_LENGTH];
+      size_t length;
+    };
+
+    /// Table of formatting codes, indexed by format (built once)
+    static const Prefix* _Prefixes()
+    {
+      struct Table {
+        Prefix prefixes[FORMATS];
+        Table()
+        {
+          prefixes[0].length = 0;
+          for ( unsigned int format = 1; format < FORMATS; ++format )
+            prefixes[format].length = _BuildPrefix(format,
+                                                   prefixes[format].bytes);
+        }
+      };
+      static const Table table;
+      return table.prefixes;
+    }
+
+    /**
+     * Assemble the formatting code for a (nonzero) format; same SGR
+     * order and separators as in decorate()
+     *
+     * @param format The formatting code
+     * @param out Output buffer with at least MAX_PREFIX_LENGTH bytes
+     *
+     * @returns The number of bytes written to "out"
+     */
+    static size_t _BuildPrefix( unsigned int format,
+                                char* out )
+    {
+      unsigned int active = 0;
+      for ( unsigned int n = format; n != 0; n &= n-1 )
+        ++active;
+
+      size_t length = 0;
+      out[length++] = '\x1b';
+      out[length++] = '[';
+      for ( unsigned int i = 0; i < 7; ++i ) {
+        if ( not (format & SGROrder(i)) )
+          continue;
+        const unsigned int code = SGRCode(SGROrder(i));
+        if ( code >= 10 )
+          out[length++] = '0' + code/10;
+        out[length++] = '0' + code%10;
+        if ( active > 1 )
+          out[length++] = ';';
+        --active;
+      }
+      out[length++] = 'm';
+      return length;
+    }
+
+    /// Append string-ified input; strings are copied directly, anything
+    /// else goes through operator<<
+    static void _Append( std::string& out, const std::string& input )
+    {
+      out.append(input);
+    }
+    static void _Append( std::string& out, const char* input )
+    {
+      out.append(input);
+    }
+    static void _Append( std::string& out, char input )
+    {
+      out.push_back(input);
+    }
+    template <typename T>
+    static void _Append( std::string& out, const T& input )
+    {
+      std::ostringstream oss;
+      oss << input;
+      out.append(oss.str());
+    }
+
+    /// Copy a string into a buffer at "length"; returns the new length
+    static size_t _Copy( char* out, size_t length, const char* input )
+    {
+      while ( *input )
+        out[length++] = *input++;
+      return length;
+    }
+
+    /// Print a number (0-255) into a buffer at "length"; returns the
+    /// new length
+    static size_t _AppendDecimal( char* out, size_t length,
+                                  unsigned char value )
+    {
+      if ( value >= 100 )
+        out[length++] = '0' + value/100;
+      if ( value >= 10 )
+        out[length++] = '0' + value/10%10;
+      out[length++] = '0' + value%10;
+      return length;
+    }
+
+    /// Length of string inputs (to reserve the result only once)
+    static size_t _Length( const std::string& input ) { return input.size(); }
+    static size_t _Length( const char* input ) { return std::strlen(input); }
+    template <typename T>
+    static size_t _Length( const T& ) { return 0; }
+
     /**
      * Check if a given SGR is active in a formatting code, and if yes,
      * feed the corresponding commands into the output stream. Decrease
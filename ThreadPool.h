@@ -0,0 +1,274 @@
+/**
+ * ===================================================================
+ *
+ * Author: Nikolaus Mayer, 2018 (mayern@cs.uni-freiburg.de)
+ *
+ * ThreadPool
+ *
+ * A small persistent pool of worker threads for data-parallel loops
+ *
+ * ===================================================================
+ *
+ * Usage example:
+ *
+ * >
+ * > #include <vector>
+ * > #include "ThreadPool.h"
+ * >
+ * > int main(int argc, char** argv)
+ * > {
+ * >   std::vector<float> v(1000);
+ * >
+ * >   /// Run 1000 tasks on (at most) 4 threads, including this one
+ * >   ThreadPool::ParallelFor(v.size(), 4, [&](size_t i) { v[i] = i*i; });
+ * >   return 0;
+ * > }
+ * >
+ *
+ * ===================================================================
+ */
+
+#ifndef THREADPOOL_H__
+#define THREADPOOL_H__
+
+// System/STL
+#include <algorithm>      // std::min
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>        // size_t
+#include <exception>      // std::exception_ptr
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+namespace ThreadPool {
+
+
+  /**
+   * Worker threads that sleep until a loop is run, then all pick
+   * tasks from a shared counter
+   *
+   * The calling thread works on the loop as well, so a pool with N
+   * workers runs loops on up to N+1 threads. Only one loop runs at a
+   * time; run() calls that find the pool busy, and run() calls made
+   * from inside a task, execute their loop serially instead of
+   * waiting or deadlocking.
+   *
+   * If a task throws, no further tasks of its loop are started; run()
+   * waits for the tasks that are already running and then rethrows
+   * the first exception on the calling thread.
+   */
+  class ThreadPool {
+    public:
+      /// Constructor
+      explicit ThreadPool( size_t workers=0 )
+        : m_generation(0),
+          m_stop(false),
+          m_task(0),
+          m_task_count(0),
+          m_participants(0),
+          m_next_task(0),
+          m_busy_workers(0)
+      {
+        reserve(workers);
+      };
+
+      /// Destructor; waits for all workers to finish
+      ~ThreadPool()
+      {
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_stop = true;
+        }
+        m_wake.notify_all();
+        for ( size_t i = 0; i < m_workers.size(); ++i )
+          m_workers[i].join();
+      };
+
+      /// Number of worker threads (not counting callers of run())
+      size_t size() const { return m_workers.size(); };
+
+      /// Grow the pool to at least "workers" worker threads; does
+      /// nothing while a loop is running
+      void reserve( size_t workers )
+      {
+        if ( _InsideTask() )
+          return;
+        std::unique_lock<std::mutex> lock(m_run_mutex, std::try_to_lock);
+        if ( not lock.owns_lock() )
+          return;
+        while ( m_workers.size() < workers )
+          m_workers.push_back(std::thread(&ThreadPool::_work, this,
+                                          m_workers.size(),
+                                          m_generation));
+      }
+
+      /**
+       * Run task(0) ... task(count-1) and return when all are done
+       * (or rethrow the first exception of a task, see above)
+       *
+       * @param count Number of tasks
+       * @param threads Maximum number of threads to use, including the
+       *        calling thread
+       * @param task Function to call with every task index
+       */
+      void run( size_t count,
+                size_t threads,
+                const std::function<void(size_t)>& task )
+      {
+        std::unique_lock<std::mutex> run_lock;
+        if ( threads > 1 and count > 1 and not _InsideTask() )
+          run_lock = std::unique_lock<std::mutex>(m_run_mutex,
+                                                  std::try_to_lock);
+        const size_t helpers = run_lock.owns_lock()
+                               ? std::min(std::min(threads, count)-1,
+                                          m_workers.size())
+                               : 0;
+        if ( helpers == 0 ) {
+          for ( size_t i = 0; i < count; ++i )
+            task(i);
+          return;
+        }
+
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_task = &task;
+          m_task_count = count;
+          m_participants = helpers;
+          m_next_task = 0;
+          m_busy_workers = helpers;
+          ++m_generation;
+        }
+        m_wake.notify_all();
+
+        _InsideTask() = true;
+        _drain();
+        _InsideTask() = false;
+
+        std::exception_ptr error;
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_done.wait(lock, [this]{ return m_busy_workers == 0; });
+          m_task = 0;
+          error = m_error;
+          m_error = std::exception_ptr();
+        }
+        if ( error )
+          std::rethrow_exception(error);
+      }
+
+    private:
+      /// Worker thread main loop; "seen" is the loop generation at the
+      /// time the worker was created
+      void _work( size_t index,
+                  size_t seen )
+      {
+        while ( true ) {
+          {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]{ return m_stop or
+                                          m_generation != seen; });
+            if ( m_stop )
+              return;
+            seen = m_generation;
+            if ( index >= m_participants )
+              continue;
+          }
+
+          _InsideTask() = true;
+          _drain();
+          _InsideTask() = false;
+
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if ( --m_busy_workers == 0 )
+            m_done.notify_one();
+        }
+      }
+
+      /// Take tasks from the shared counter until none are left; an
+      /// exception is kept for run() and ends the loop
+      void _drain()
+      {
+        try {
+          size_t i;
+          while ( (i = m_next_task.fetch_add(1)) < m_task_count )
+            (*m_task)(i);
+        } catch ( ... ) {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if ( not m_error )
+            m_error = std::current_exception();
+          m_next_task = m_task_count;
+        }
+      }
+
+      /// TRUE on any thread while it runs tasks of this pool
+      static bool& _InsideTask()
+      {
+        static thread_local bool inside = false;
+        return inside;
+      }
+
+      std::vector<std::thread> m_workers;
+      std::mutex m_run_mutex;
+      std::mutex m_mutex;
+      std::condition_variable m_wake;
+      std::condition_variable m_done;
+      size_t m_generation;
+      bool m_stop;
+
+      /// The loop currently being run
+      const std::function<void(size_t)>* m_task;
+      size_t m_task_count;
+      size_t m_participants;
+      std::atomic<size_t> m_next_task;
+      size_t m_busy_workers;
+      /// The first exception thrown by a task of the loop
+      std::exception_ptr m_error;
+  };
+
+
+  /**
+   * The process-wide pool, grown on demand and kept for later loops
+   */
+  inline ThreadPool& Shared()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+
+  /**
+   * Run task(0) ... task(count-1) on up to "threads" threads of the
+   * shared pool (including the calling thread)
+   *
+   * The shared pool keeps every thread it starts, so it only grows
+   * as far as a loop can use: never beyond one thread per task, nor
+   * beyond one thread per CPU.
+   *
+   * @param count Number of tasks
+   * @param threads Maximum number of threads; 0 means one per CPU
+   * @param task Function to call with every task index
+   */
+  inline void ParallelFor( size_t count,
+                           size_t threads,
+                           const std::function<void(size_t)>& task )
+  {
+    const size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    if ( threads == 0 or threads > cpus )
+      threads = cpus;
+    threads = std::min(threads, count);
+    if ( threads > 1 )
+      Shared().reserve(threads-1);
+    Shared().run(count, threads, task);
+  }
+
+
+}  // namespace ThreadPool
+
+
+
+#endif  // THREADPOOL_H__
+
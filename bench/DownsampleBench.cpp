@@ -0,0 +1,142 @@
+/**
+ * Downsampling throughput of the built-in decimations (area binning,
+ * M4, LTTB) on a float random walk, reduced to 200 plot columns
+ *
+ *   bench/DownsampleBench N          N values in memory
+ *   bench/DownsampleBench N FILE     N values memory-mapped from FILE
+ *                                    (raw f32, written first if it is
+ *                                    shorter than N values)
+ *
+ * N may be written as e.g. 1e9. The FILE form measures inputs that do
+ * not fit into memory next to the process: the page cache holds what
+ * it can, so the first pass over a large file includes reading it.
+ */
+
+/// System/STL
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+/// Local files
+#include "DataInput.h"
+#include "Sparkline.h"
+
+
+
+/// Plot columns
+const size_t WIDTH = 200;
+/// Passes per decimation (the fastest one is reported)
+const int PASSES = 3;
+
+
+/**
+ * Random walk values, the same for every run
+ */
+class RandomWalk {
+  public:
+    RandomWalk() : m_generator(1), m_value(0.f) {};
+    float next() { m_value += m_distribution(m_generator); return m_value; };
+  private:
+    std::mt19937 m_generator;
+    std::normal_distribution<float> m_distribution;
+    float m_value;
+};
+
+
+/**
+ * Write "n" random walk values to "path" unless it already holds them
+ */
+void EnsureFile( const std::string& path,
+                 size_t n )
+{
+  struct stat st;
+  if (::stat(path.c_str(), &st) == 0 and (size_t)st.st_size >= n*sizeof(float))
+    return;
+  std::cerr << "Writing " << n << " values to " << path << std::endl;
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (not file)
+    throw std::runtime_error("Cannot write \"" + path + "\"");
+  RandomWalk walk;
+  std::vector<float> chunk(1 << 20);
+  for (size_t done = 0; done < n; ) {
+    const size_t count = std::min(chunk.size(), n-done);
+    for (size_t i = 0; i < count; ++i)
+      chunk[i] = walk.next();
+    if (std::fwrite(chunk.data(), sizeof(float), count, file) != count) {
+      std::fclose(file);
+      throw std::runtime_error("Cannot write \"" + path + "\"");
+    }
+    done += count;
+  }
+  std::fclose(file);
+}
+
+
+/**
+ * Time every built-in decimation on "data"
+ */
+void Run( const float* data,
+          size_t n )
+{
+  static const char* const names[] = { "area", "m4", "lttb" };
+  const Sparkline::Decimation decimations[] = { Sparkline::Area,
+                                                Sparkline::M4,
+                                                Sparkline::LTTB };
+  std::vector<float> bins(WIDTH), bins_min(WIDTH), bins_max(WIDTH);
+
+  for (int k = 0; k < 3; ++k) {
+    const Sparkline::Downsampler<float>& downsampler =
+                          Sparkline::BuiltinDownsampler<float>(decimations[k]);
+    double best = 0.;
+    for (int pass = 0; pass < PASSES; ++pass) {
+      const std::chrono::steady_clock::time_point start =
+                          std::chrono::steady_clock::now();
+      downsampler(data, n, bins.data(), bins_min.data(), bins_max.data(),
+                  WIDTH, Sparkline::Mean);
+      const double ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now()-start).count();
+      std::printf("n=%zu %-4s pass %d: %9.1f ms\n", n, names[k], pass+1, ms);
+      if (pass == 0 or ms < best)
+        best = ms;
+    }
+    std::printf("n=%zu %-4s best:   %9.1f ms (%.2f ns/value)\n",
+                n, names[k], best, 1e6*best/n);
+  }
+}
+
+
+int main( int argc, char** argv )
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " N [FILE]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const size_t n = (size_t)std::strtod(argv[1], 0);
+  if (n < WIDTH) {
+    std::cerr << "N must be at least " << WIDTH << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    if (argc > 2) {
+      EnsureFile(argv[2], n);
+      DataInput::MappedFile file(argv[2]);
+      Run(reinterpret_cast<const float*>(file.begin()), n);
+    } else {
+      std::vector<float> data(n);
+      RandomWalk walk;
+      for (size_t i = 0; i < n; ++i)
+        data[i] = walk.next();
+      Run(data.data(), n);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/**
+ * Output size of colored plots: how many bytes the escape codes add
+ * to the visible text, now that SparklineWriter only writes them when
+ * the style changes
+ *
+ *   COLUMNS=1000 bench/StyleBench | cat
+ *
+ * Every configuration renders the same 1000-value input with and
+ * without colors; the uncolored output is the visible text. Plots
+ * never get wider than the terminal, hence the pipe and COLUMNS.
+ */
+
+/// System/STL
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+/// Local files
+#include "Sparkline.h"
+
+
+
+/// Renders per configuration for the timing
+const int RENDERS = 2000;
+
+
+/**
+ * One plot configuration
+ */
+struct Case {
+  const char* name;
+  size_t height;
+  size_t width;
+  bool box;
+  Sparkline::Gradient gradient;
+};
+
+
+/**
+ * Bytes of one rendering of "data"
+ */
+size_t Render( const std::vector<float>& data,
+               const Sparkline::Configuration<float>& config,
+               std::string& out )
+{
+  out.clear();
+  Sparkline::StringSink sink(out);
+  Sparkline::SparklineTo(sink, data.data(), data.size(), config);
+  return out.size();
+}
+
+
+int main()
+{
+  std::vector<float> data(1000);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = std::sin(i*.01) + .3*std::sin(i*.37);
+
+  const Case cases[] = {
+    { "200x10",                10, 200, true,  Sparkline::Solid      },
+    { "200x1",                  1, 200, true,  Sparkline::Solid      },
+    { "80x5 no box",            5,  80, false, Sparkline::Solid      },
+    { "200x10 gradient 256",   10, 200, true,  Sparkline::Palette256 },
+    { "200x10 gradient 24bit", 10, 200, true,  Sparkline::TrueColor  },
+  };
+
+  std::printf("%-22s %9s %9s %9s %11s\n",
+              "plot", "colored", "visible", "overhead", "us/render");
+  std::string out;
+  for (size_t c = 0; c < sizeof(cases)/sizeof(cases[0]); ++c) {
+    Sparkline::Configuration<float> config(cases[c].height,
+                                           cases[c].width,
+                                           cases[c].box);
+    config.setGradient(cases[c].gradient);
+    config.setColor(false);
+    const size_t visible = Render(data, config, out);
+    config.setColor(true);
+    const size_t colored = Render(data, config, out);
+
+    const std::chrono::steady_clock::time_point start =
+                          std::chrono::steady_clock::now();
+    for (int r = 0; r < RENDERS; ++r)
+      Render(data, config, out);
+    const double us = std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now()-start).count();
+
+    std::printf("%-22s %9zu %9zu %8.1f%% %11.1f\n",
+                cases[c].name, colored, visible,
+                100.*(colored-visible)/visible, us/RENDERS);
+  }
+  return 0;
+}
@@ -4,11 +4,238 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
+#include <unistd.h>
 /// Local files
+#include "DataInput.h"
+#include "LivePlot.h"
+#include "PyramidIndex.h"
 #include "Sparkline.h"
+#include "SparklineGrid.h"
+#include "ThreadPool.h"
+
+
+
+/**
+ * Plot a raw binary buffer as values of type T
+ *
+ * @param first Start of the byte range
+ * @param last One past the end of the byte range
+ * @param layout Offset, stride and byte order of the values
+ * @param config Plot configuration
+ * @param from Index of the first value to plot
+ * @param to One past the index of the last value to plot
+ */
+template <typename T>
+void PlotBinary( const char* first,
+                 const char* last,
+                 const DataInput::BinaryLayout& layout,
+                 const Sparkline::Configuration<float>& config,
+                 size_t from,
+                 size_t to )
+{
+  /// Narrow the byte range to the selected values; nothing outside
+  /// of it is touched
+  const size_t total = DataInput::BinaryValues<T>(first, last, layout).size();
+  to   = std::min(to, total);
+  from = std::min(from, to);
+  DataInput::BinaryLayout window(layout);
+  const size_t stride = layout.stride == 0 ? sizeof(T) : layout.stride;
+  window.offset += from*stride;
+  if (to > from)
+    last = first + window.offset + (to-from-1)*stride + sizeof(T);
+
+  std::vector<T> storage;
+  size_t n;
+  const T* values = DataInput::BinaryView<T>(first, last, window, storage, n);
+  std::cout << Sparkline::Sparkline<T>(values,
+                                       n,
+                                       Sparkline::Configuration<T>(config))
+            << std::endl;
+}
+
+
+/**
+ * Plot a raw binary buffer, dispatching on the element type
+ */
+void PlotBinary( const char* first,
+                 const char* last,
+                 DataInput::BinaryFormat format,
+                 const DataInput::BinaryLayout& layout,
+                 const Sparkline::Configuration<float>& config,
+                 size_t from,
+                 size_t to )
+{
+  switch (format) {
+    case DataInput::F32: PlotBinary<float   >(first, last, layout, config, from, to); break;
+    case DataInput::F64: PlotBinary<double  >(first, last, layout, config, from, to); break;
+    case DataInput::I32: PlotBinary<int32_t >(first, last, layout, config, from, to); break;
+    case DataInput::I64: PlotBinary<int64_t >(first, last, layout, config, from, to); break;
+    case DataInput::U16: PlotBinary<uint16_t>(first, last, layout, config, from, to); break;
+  }
+}
+
+
+
+/**
+ * Plot a memory-mapped binary file as values of type T through its
+ * pyramid index
+ */
+template <typename T>
+void PlotIndexed( const PyramidIndex::Index& index,
+                  const char* first,
+                  const char* last,
+                  const DataInput::BinaryLayout& layout,
+                  const Sparkline::Configuration<float>& config,
+                  size_t from,
+                  size_t to )
+{
+  DataInput::BinaryValues<T> values(first, last, layout);
+  std::cout << PyramidIndex::Plot(index, values, from, to,
+                                  Sparkline::Configuration<T>(config))
+            << std::endl;
+}
+
+
+/**
+ * Plot through a pyramid index, dispatching on the element type
+ */
+void PlotIndexed( const PyramidIndex::Index& index,
+                  const char* first,
+                  const char* last,
+                  DataInput::BinaryFormat format,
+                  const DataInput::BinaryLayout& layout,
+                  const Sparkline::Configuration<float>& config,
+                  size_t from,
+                  size_t to )
+{
+  switch (format) {
+    case DataInput::F32: PlotIndexed<float   >(index, first, last, layout, config, from, to); break;
+    case DataInput::F64: PlotIndexed<double  >(index, first, last, layout, config, from, to); break;
+    case DataInput::I32: PlotIndexed<int32_t >(index, first, last, layout, config, from, to); break;
+    case DataInput::I64: PlotIndexed<int64_t >(index, first, last, layout, config, from, to); break;
+    case DataInput::U16: PlotIndexed<uint16_t>(index, first, last, layout, config, from, to); break;
+  }
+}
+
+
+/**
+ * Open the pyramid index of a binary file, if there is an up-to-date
+ * one; a stale or broken index is reported and ignored, and so is any
+ * index if the plot is not area-binned
+ *
+ * @returns The index (owned by the caller), or 0
+ */
+PyramidIndex::Index* OpenIndex( const std::string& file,
+                                DataInput::BinaryFormat format,
+                                const DataInput::BinaryLayout& layout,
+                                Sparkline::Decimation decimation )
+{
+  const std::string path = PyramidIndex::SidecarPath(file);
+  if (::access(path.c_str(), F_OK) != 0)
+    return 0;
+  if (decimation != Sparkline::Area) {
+    std::cerr << "Ignoring index " << path
+              << ": --decimate needs the raw values" << std::endl;
+    return 0;
+  }
+  try {
+    std::unique_ptr<PyramidIndex::Index> index(new PyramidIndex::Index(path));
+    if (index->matches(PyramidIndex::Describe(file, format, layout)))
+      return index.release();
+    std::cerr << "Ignoring out-of-date index " << path << std::endl;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Ignoring index: " << e.what() << std::endl;
+  }
+  return 0;
+}
+
+
+/**
+ * Write the pyramid index of a binary file
+ *
+ * @returns The size of the index file in bytes
+ */
+size_t BuildIndex( const std::string& file,
+                   DataInput::BinaryFormat format,
+                   const DataInput::BinaryLayout& layout )
+{
+  DataInput::MappedFile mapped(file);
+  if (not mapped.regular())
+    throw std::runtime_error("Cannot index \"" + file + "\": not a regular file");
+  const PyramidIndex::Header identity = PyramidIndex::Describe(file, format, layout);
+  const std::string path = PyramidIndex::SidecarPath(file);
+  switch (format) {
+    case DataInput::F32: return PyramidIndex::Build(DataInput::BinaryValues<float   >(mapped.begin(), mapped.end(), layout), identity, path);
+    case DataInput::F64: return PyramidIndex::Build(DataInput::BinaryValues<double  >(mapped.begin(), mapped.end(), layout), identity, path);
+    case DataInput::I32: return PyramidIndex::Build(DataInput::BinaryValues<int32_t >(mapped.begin(), mapped.end(), layout), identity, path);
+    case DataInput::I64: return PyramidIndex::Build(DataInput::BinaryValues<int64_t >(mapped.begin(), mapped.end(), layout), identity, path);
+    case DataInput::U16: return PyramidIndex::Build(DataInput::BinaryValues<uint16_t>(mapped.begin(), mapped.end(), layout), identity, path);
+  }
+  return 0;
+}
+
+
+/**
+ * Title of a table column: its header entry, or else its number
+ */
+std::string ColumnTitle( const DataInput::ColumnTable<float>& table,
+                         size_t c )
+{
+  return table.titles.empty() ? "Column " + std::to_string(c+1)
+                              : table.titles[c];
+}
+
+
+/**
+ * Plot every column of a table, rendering the columns in parallel
+ *
+ * @param table The values
+ * @param config Plot configuration; the titles are taken from the
+ *        table header, or else numbered
+ * @param stack Iff TRUE, print the plots without gaps and only show
+ *        the x-axis (which all columns share) below the last one
+ * @param threads Maximum number of rendering threads; 0 means one per
+ *        CPU
+ */
+void PlotColumns( const DataInput::ColumnTable<float>& table,
+                  const Sparkline::Configuration<float>& config,
+                  bool stack,
+                  size_t threads )
+{
+  const size_t n = table.width();
+  if (table.rows() == 0)
+    throw std::runtime_error("No data to plot");
+
+  std::vector<std::string> plots(n);
+  std::vector<std::string> errors(n);
+  ThreadPool::ParallelFor(n, threads, [&](size_t c) {
+    Sparkline::Configuration<float> column_config(config);
+    column_config.setThreads(1);
+    column_config.setTitle(ColumnTitle(table, c));
+    column_config.setXAxis(not stack or c+1 == n);
+    try {
+      plots[c] = Sparkline::Sparkline<float>(table.columns[c].data(),
+                                             table.rows(),
+                                             column_config);
+    } catch (const std::runtime_error& e) {
+      errors[c] = e.what();
+    }
+  });
+
+  for (size_t c = 0; c < n; ++c)
+    if (not errors[c].empty())
+      throw std::runtime_error(errors[c]);
+  for (size_t c = 0; c < n; ++c) {
+    std::cout << plots[c];
+    /// Boxed stacked plots already end with their lower border line
+    if (not stack or not config.enclose_in_box or c+1 == n)
+      std::cout << std::endl;
+  }
+}
 
 
 
@@ -21,6 +248,31 @@ int main(int argc, char** argv) {
   std::string title = "SimplePlot";
   bool box   = true;
   bool color = true;
+  bool stop_at_invalid = true;
+  std::string file;
+  bool binary = false;
+  DataInput::BinaryFormat binary_format = DataInput::F32;
+  DataInput::BinaryLayout binary_layout;
+  bool stream = false;
+  size_t count = 0;
+  bool follow = false;
+  float fps = 10.f;
+  size_t capacity = 0;
+  bool incremental = true;
+  bool stats = false;
+  Sparkline::Aggregation aggregation = Sparkline::Mean;
+  Sparkline::Decimation decimation = Sparkline::Area;
+  size_t threads = 1;
+  bool columns = false;
+  bool stack = false;
+  bool grid = false;
+  size_t column_threads = 0;
+  bool build_index = false;
+  size_t from = 0;
+  size_t to = std::numeric_limits<size_t>::max();
+  Sparkline::Upsampling upsampling = Sparkline::Step;
+  Sparkline::Gradient gradient = Sparkline::Solid;
+  Sparkline::Rendering rendering = Sparkline::Blocks;
 
   #define INCREMENT_i_AND_CHECK ++i; if (i>=argc) break;
   for (int i = 1; i < argc; ++i) {
@@ -30,16 +282,42 @@ int main(int argc, char** argv) {
                 << std::endl
                 << "Plot stuff like this:" << std::endl << std::endl
                 << Sparkline::ShowExampleGaussian() << std::endl
-                << "Values to be plotted are read from STDIN." << std::endl
+                << "Values to be plotted are read from STDIN or --file." << std::endl
                 << std::endl
                 << "Options:" << std::endl
-                << "  --max      " << "Upper plot y-limit" << std::endl
-                << "  --min      " << "Lower plot y-limit" << std::endl
-                << "  --height   " << "Plot height in lines" << std::endl
-                << "  --width    " << "Plot width in characters" << std::endl
-                << "  --title    " << "Plot title" << std::endl
-                << "  --no-box   " << "Disable enclosing box" << std::endl
-                << "  --no-color " << "Disable color output" << std::endl
+                << "  --max           " << "Upper plot y-limit" << std::endl
+                << "  --min           " << "Lower plot y-limit" << std::endl
+                << "  --height        " << "Plot height in lines" << std::endl
+                << "  --width         " << "Plot width in characters" << std::endl
+                << "  --title         " << "Plot title" << std::endl
+                << "  --no-box        " << "Disable enclosing box" << std::endl
+                << "  --no-color      " << "Disable color output" << std::endl
+                << "  --gradient      " << "Color bars by height: none (default), 256 or truecolor" << std::endl
+                << "  --render        " << "Bar glyphs: blocks (default) or braille (twice the columns, half the levels)" << std::endl
+                << "  --braille       " << "Same as --render braille" << std::endl
+                << "  --file          " << "Read values from this file instead of STDIN" << std::endl
+                << "  --agg           " << "Per-column aggregation: mean, min, max, minmax, last or sum" << std::endl
+                << "  --decimate      " << "Downsampling: area (default), m4 or lttb" << std::endl
+                << "  --upsample      " << "Fill plots wider than the data: step (default), nearest or linear" << std::endl
+                << "  --threads       " << "Threads for downsampling (default 1) and for --columns/--stack/--grid plots (default one per CPU); 0: one per CPU" << std::endl
+                << "  --columns       " << "Plot every column of a table (whitespace/comma separated)" << std::endl
+                << "  --stack         " << "Stack --columns plots on a shared x-axis" << std::endl
+                << "  --grid          " << "Arrange --columns plots in a grid that fills the terminal" << std::endl
+                << "  --binary        " << "Read raw values: f32, f64, i32, i64 or u16" << std::endl
+                << "  --endian        " << "Byte order of --binary values: little (default) or big" << std::endl
+                << "  --offset        " << "Byte offset of the first --binary value" << std::endl
+                << "  --stride        " << "Byte distance between --binary values" << std::endl
+                << "  --build-index   " << "Write a pyramid index of a --binary file, for fast plotting" << std::endl
+                << "  --from          " << "Index of the first value to plot" << std::endl
+                << "  --to            " << "Index behind the last value to plot" << std::endl
+                << "  --count         " << "Number of input values; plot while reading" << std::endl
+                << "  --stream        " << "Plot while reading, without knowing --count" << std::endl
+                << "  --follow        " << "Keep reading and redraw the plot in place" << std::endl
+                << "  --fps           " << "Maximum redraws per second in --follow mode" << std::endl
+                << "  --capacity      " << "Number of recent values shown in --follow mode" << std::endl
+                << "  --full-redraw   " << "Redraw complete frames in --follow mode" << std::endl
+                << "  --stats         " << "Print output byte counts of --follow mode to STDERR" << std::endl
+                << "  --skip-invalid  " << "Skip non-numbers instead of stopping" << std::endl
                 << std::endl;
       return EXIT_FAILURE;
     } else if (std::strcmp(argv[i], "--max"     ) == 0) {
@@ -61,34 +339,307 @@ int main(int argc, char** argv) {
       box = false;
     } else if (std::strcmp(argv[i], "--no-color") == 0) {
       color = false;
+    } else if (std::strcmp(argv[i], "--gradient") == 0) {
+      INCREMENT_i_AND_CHECK;
+      if (not Sparkline::ParseGradient(argv[i], gradient)) {
+        std::cerr << "Unknown gradient: \"" << argv[i] << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--render"  ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      if (not Sparkline::ParseRendering(argv[i], rendering)) {
+        std::cerr << "Unknown rendering: \"" << argv[i] << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--braille" ) == 0) {
+      rendering = Sparkline::Braille;
+    } else if (std::strcmp(argv[i], "--file"    ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      file = argv[i];
+    } else if (std::strcmp(argv[i], "--agg"     ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      if (not Sparkline::ParseAggregation(argv[i], aggregation)) {
+        std::cerr << "Unknown aggregation: \"" << argv[i] << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--decimate") == 0) {
+      INCREMENT_i_AND_CHECK;
+      if (not Sparkline::ParseDecimation(argv[i], decimation)) {
+        std::cerr << "Unknown decimation: \"" << argv[i] << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--upsample") == 0) {
+      INCREMENT_i_AND_CHECK;
+      if (not Sparkline::ParseUpsampling(argv[i], upsampling)) {
+        std::cerr << "Unknown upsampling: \"" << argv[i] << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--threads" ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      threads = std::strtoull(argv[i], 0, 10);
+      column_threads = threads;
+    } else if (std::strcmp(argv[i], "--columns" ) == 0) {
+      columns = true;
+    } else if (std::strcmp(argv[i], "--stack"   ) == 0) {
+      columns = true;
+      stack = true;
+    } else if (std::strcmp(argv[i], "--grid"    ) == 0) {
+      columns = true;
+      grid = true;
+    } else if (std::strcmp(argv[i], "--binary"  ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      if (not DataInput::ParseBinaryFormat(argv[i], binary_format)) {
+        std::cerr << "Unknown binary format: \"" << argv[i] << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+      binary = true;
+    } else if (std::strcmp(argv[i], "--endian"  ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      if (not DataInput::ParseByteOrder(argv[i], binary_layout.big_endian)) {
+        std::cerr << "Unknown byte order: \"" << argv[i] << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--offset"  ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      binary_layout.offset = std::strtoull(argv[i], 0, 10);
+    } else if (std::strcmp(argv[i], "--stride"  ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      binary_layout.stride = std::strtoull(argv[i], 0, 10);
+    } else if (std::strcmp(argv[i], "--build-index") == 0) {
+      INCREMENT_i_AND_CHECK;
+      file = argv[i];
+      binary = true;
+      build_index = true;
+    } else if (std::strcmp(argv[i], "--from"    ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      from = std::strtoull(argv[i], 0, 10);
+    } else if (std::strcmp(argv[i], "--to"      ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      to = std::strtoull(argv[i], 0, 10);
+    } else if (std::strcmp(argv[i], "--count"   ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      count = std::strtoull(argv[i], 0, 10);
+      stream = true;
+    } else if (std::strcmp(argv[i], "--stream"  ) == 0) {
+      stream = true;
+    } else if (std::strcmp(argv[i], "--follow"  ) == 0) {
+      follow = true;
+    } else if (std::strcmp(argv[i], "--fps"     ) == 0) {
+      INCREMENT_i_AND_CHECK;
+      fps = std::atof(argv[i]);
+    } else if (std::strcmp(argv[i], "--capacity") == 0) {
+      INCREMENT_i_AND_CHECK;
+      capacity = std::strtoull(argv[i], 0, 10);
+    } else if (std::strcmp(argv[i], "--full-redraw") == 0) {
+      incremental = false;
+    } else if (std::strcmp(argv[i], "--stats"   ) == 0) {
+      stats = true;
+    } else if (std::strcmp(argv[i], "--skip-invalid") == 0) {
+      stop_at_invalid = false;
     } else {
       std::cerr << "Unrecognized option: \"" << argv[i] << "\"" << std::endl;
     }
   }
   #undef INCREMENT_i_AND_CHECK
 
+  Sparkline::Configuration<float> config(height,
+                                         width,
+                                         box,
+                                         color,
+                                         title,
+                                         minv,
+                                         maxv);
+  config.setAggregation(aggregation);
+  config.setDecimation(decimation);
+  config.setThreads(threads);
+  config.setUpsampling(upsampling);
+  config.setGradient(gradient);
+  config.setRendering(rendering);
+  config.setXOffset(from);
+  if (to <= from) {
+    std::cerr << "Empty range: --from " << from << " --to " << to << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /// Table mode: parse all columns in one pass, then plot each
+  if (columns) {
+    if (binary or stream or follow) {
+      std::cerr << "--columns cannot be combined with --binary, --count, "
+                << "--stream or --follow" << std::endl;
+      return EXIT_FAILURE;
+    }
+    try {
+      DataInput::ColumnTable<float> table;
+      std::vector<char> buffer;
+      if (file.empty()) {
+        DataInput::ReadAll(STDIN_FILENO, buffer);
+        DataInput::ParseTable(buffer.data(), buffer.data()+buffer.size(),
+                              table, stop_at_invalid);
+      } else {
+        DataInput::MappedFile mapped(file);
+        if (mapped.regular()) {
+          DataInput::ParseTable(mapped.begin(), mapped.end(),
+                                table, stop_at_invalid);
+        } else {
+          DataInput::ReadAll(mapped.fd(), buffer);
+          DataInput::ParseTable(buffer.data(), buffer.data()+buffer.size(),
+                                table, stop_at_invalid);
+        }
+      }
+      /// Keep only the selected rows
+      for (size_t c = 0; c < table.width(); ++c) {
+        std::vector<float>& column = table.columns[c];
+        column.resize(std::min(to, column.size()));
+        column.erase(column.begin(), column.begin()+std::min(from, column.size()));
+      }
+      if (grid) {
+        if (table.rows() == 0)
+          throw std::runtime_error("No data to plot");
+        Sparkline::SparklineGrid<float> cells(config);
+        cells.setThreads(column_threads);
+        for (size_t c = 0; c < table.width(); ++c)
+          cells.add(table.columns[c].data(), table.rows(),
+                    ColumnTitle(table, c));
+        cells.write(STDOUT_FILENO);
+      } else {
+        PlotColumns(table, config, stack, column_threads);
+      }
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /// Live mode: show the most recent values until the input ends
+  if (follow) {
+    if (from > 0 or to != std::numeric_limits<size_t>::max()) {
+      std::cerr << "--from and --to cannot be combined with --follow" << std::endl;
+      return EXIT_FAILURE;
+    }
+    /// One value per plot column (two per character with Braille)
+    if (capacity == 0)
+      capacity = Sparkline::BinCount(config,
+                                     std::numeric_limits<unsigned short>::max());
+    try {
+      if (file.empty()) {
+        LivePlot::Follow(STDIN_FILENO, config, capacity, fps,
+                         std::cout, stop_at_invalid, incremental,
+                         stats ? &std::cerr : 0);
+      } else {
+        DataInput::OpenFile input(file);
+        LivePlot::Follow(input.fd(), config, capacity, fps,
+                         std::cout, stop_at_invalid, incremental,
+                         stats ? &std::cerr : 0);
+      }
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /// Index building: one scan now, O(width) plots later
+  if (build_index) {
+    try {
+      const size_t bytes = BuildIndex(file, binary_format, binary_layout);
+      std::cout << "Wrote " << PyramidIndex::SidecarPath(file)
+                << " (" << bytes << " bytes)" << std::endl;
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /// Binary input is plotted in its own element type
+  if (binary) {
+    try {
+      std::vector<char> buffer;
+      if (file.empty()) {
+        DataInput::ReadAll(STDIN_FILENO, buffer);
+        PlotBinary(buffer.data(), buffer.data()+buffer.size(),
+                   binary_format, binary_layout, config, from, to);
+      } else {
+        DataInput::MappedFile mapped(file);
+        std::unique_ptr<PyramidIndex::Index> index;
+        if (mapped.regular())
+          index.reset(OpenIndex(file, binary_format, binary_layout,
+                                decimation));
+        if (index) {
+          PlotIndexed(*index, mapped.begin(), mapped.end(),
+                      binary_format, binary_layout, config, from, to);
+        } else if (mapped.regular()) {
+          PlotBinary(mapped.begin(), mapped.end(),
+                     binary_format, binary_layout, config, from, to);
+        } else {
+          DataInput::ReadAll(mapped.fd(), buffer);
+          PlotBinary(buffer.data(), buffer.data()+buffer.size(),
+                     binary_format, binary_layout, config, from, to);
+        }
+      }
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /// Text input is either collected completely, or binned on the fly;
+  /// values before --from are only counted, not parsed, and reading
+  /// stops at --to, or one value past --count to detect a mismatch
   std::vector<float> data;
-  {
-    float dummy;
-    while (!std::cin.eof())
-    {
-      std::cin >> dummy;
-      if (std::cin.fail())
-        break;
-      data.push_back(dummy);
+  Sparkline::StreamingSparkline<float> streaming(config, count);
+  size_t limit = to-from;
+  if (count > 0 and count < limit)
+    limit = count+1;
+  try {
+    if (file.empty()) {
+      DataInput::BufferedReader reader(STDIN_FILENO, stop_at_invalid);
+      reader.skip(from);
+      if (stream)
+        reader.readAll(streaming, limit);
+      else
+        reader.readAll(data, limit);
+    } else {
+      /// Regular files are parsed in place; pipes, FIFOs etc. are read
+      DataInput::MappedFile mapped(file);
+      if (mapped.regular()) {
+        size_t skipped = from;
+        const char* first = DataInput::SkipTokens(mapped.begin(),
+                                                  mapped.end(), skipped);
+        if (stream)
+          DataInput::ParseAll(first, mapped.end(),
+                              streaming, stop_at_invalid, limit);
+        else
+          DataInput::ParseAll(first, mapped.end(),
+                              data, stop_at_invalid, limit);
+      } else {
+        DataInput::BufferedReader reader(mapped.fd(), stop_at_invalid);
+        reader.skip(from);
+        if (stream)
+          reader.readAll(streaming, limit);
+        else
+          reader.readAll(data, limit);
+      }
     }
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
   }
 
-  std::cout << Sparkline::Sparkline<float>(data.data(),
-                                           data.size(),
-                                           height,
-                                           width,
-                                           box,
-                                           color,
-                                           title,
-                                           minv,
-                                           maxv) 
-            << std::endl;
+  try {
+    if (stream)
+      std::cout << streaming.render() << std::endl;
+    else
+      std::cout << Sparkline::Sparkline<float>(data.data(),
+                                               data.size(),
+                                               config)
+                << std::endl;
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
 
   /// Bye!
   return EXIT_SUCCESS;
@@ -0,0 +1,154 @@
+/**
+ * Tests of PyramidIndex: aggregates of integer formats must not wrap
+ * around, in the finest level, in the levels merged from it, and in
+ * the columns that are plotted from them; plots from the index equal
+ * plots of the raw values, also for sub-ranges, widths that do not
+ * divide the range, and min/max envelopes
+ *
+ *   make test
+ */
+
+/// System/STL
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <unistd.h>
+/// Local files
+#include "DataInput.h"
+#include "PyramidIndex.h"
+#include "Sparkline.h"
+
+
+
+/// Number of failed checks
+int failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (not (condition)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" \
+                << #condition << ") failed" << std::endl; \
+      ++failures; \
+    } \
+  } while (0)
+
+
+/**
+ * Check that the values [first, last) plot the same from the index as
+ * from the raw data
+ */
+template <typename T>
+void CheckPlot( const PyramidIndex::Index& index,
+                const DataInput::BinaryValues<T>& values,
+                const std::vector<T>& data,
+                size_t first,
+                size_t last,
+                size_t width,
+                Sparkline::Aggregation aggregation )
+{
+  Sparkline::Configuration<T> config(2, width, false);
+  config.setColor(false);
+  config.setAggregation(aggregation);
+  config.setXOffset(first);
+  const std::string from_index = PyramidIndex::Plot(index, values, first,
+                                                    last, config);
+  const std::string from_data = Sparkline::Sparkline(data.data()+first,
+                                                     last-first, config);
+  CHECK(from_index == from_data);
+  if (from_index != from_data)
+    std::cerr << "  [" << first << ", " << last << ") width " << width
+              << ":\n" << from_index << "\n" << from_data << std::endl;
+}
+
+
+/**
+ * Write "data" to a temporary file, index it, and check every
+ * aggregate against sums computed here
+ */
+template <typename T>
+void CheckSums( const std::vector<T>& data,
+                DataInput::BinaryFormat format )
+{
+  const char* const first = reinterpret_cast<const char*>(data.data());
+  const char* const last  = first + data.size()*sizeof(T);
+  const DataInput::BinaryLayout layout;
+  const DataInput::BinaryValues<T> values(first, last, layout);
+
+  /// One block, added directly
+  PyramidIndex::Aggregate block = PyramidIndex::Aggregate::Empty();
+  block.add(values, 0, PyramidIndex::BASE_BLOCK);
+  double expected = 0.;
+  for (size_t i = 0; i < PyramidIndex::BASE_BLOCK; ++i)
+    expected += (double)data[i];
+  CHECK(block.sum == expected);
+  CHECK(block.count == PyramidIndex::BASE_BLOCK);
+
+  /// All levels of a built index
+  char path[] = "/tmp/PyramidIndexTestXXXXXX";
+  const int fd = ::mkstemp(path);
+  CHECK(fd >= 0);
+  if (fd < 0)
+    return;
+  CHECK(::write(fd, first, last-first) == last-first);
+  ::close(fd);
+  const std::string index_path = PyramidIndex::SidecarPath(path);
+  PyramidIndex::Build(values, PyramidIndex::Describe(path, format, layout),
+                      index_path);
+  {
+    const PyramidIndex::Index index(index_path);
+    CHECK(index.values() == data.size());
+    for (size_t l = 0; l < index.levels(); ++l) {
+      const size_t span = PyramidIndex::BASE_BLOCK << l;
+      for (size_t b = 0; b < PyramidIndex::LevelSize(data.size(), l); ++b) {
+        double sum = 0.;
+        for (size_t i = b*span; i < std::min((b+1)*span, data.size()); ++i)
+          sum += (double)data[i];
+        CHECK(index.level(l)[b].sum == sum);
+      }
+    }
+
+    /// Plotted columns show the mean (or the min/max envelope) of
+    /// their values, like a plot of the raw data; the ranges are long
+    /// enough to be plotted from the index
+    const size_t n = data.size();
+    CheckPlot(index, values, data, 0, n, 4, Sparkline::Mean);
+    CheckPlot(index, values, data, 0, n, 7, Sparkline::Mean);
+    CheckPlot(index, values, data, 0, n-1001, 4, Sparkline::Mean);
+    CheckPlot(index, values, data, 0, n/3, 5, Sparkline::Mean);
+    CheckPlot(index, values, data, n-n/3, n, 5, Sparkline::Mean);
+    CheckPlot(index, values, data, 0, n, 7, Sparkline::MinMax);
+    CheckPlot(index, values, data, 333, n/2+7, 6, Sparkline::MinMax);
+  }
+  std::remove(index_path.c_str());
+  std::remove(path);
+}
+
+
+int main()
+{
+  /// u16: a block of 1024 values near 60000 sums to about 6e7
+  {
+    std::vector<uint16_t> data(64*PyramidIndex::BASE_BLOCK);
+    for (size_t i = 0; i < data.size(); ++i)
+      data[i] = (uint16_t)(i < data.size()/2 ? 30000 : 60000 + i%5000);
+    CheckSums(data, DataInput::U16);
+  }
+  /// i32: a block of values near 2e9 sums to about 2e12
+  {
+    std::vector<int32_t> data(64*PyramidIndex::BASE_BLOCK);
+    for (size_t i = 0; i < data.size(); ++i)
+      data[i] = (int32_t)(i < data.size()/2 ? -2000000000 + (int32_t)i
+                                            :  2000000000 - (int32_t)i);
+    CheckSums(data, DataInput::I32);
+  }
+
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "PyramidIndexTest: all checks passed" << std::endl;
+  return EXIT_SUCCESS;
+}
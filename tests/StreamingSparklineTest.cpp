@@ -0,0 +1,86 @@
+/**
+ * Tests of StreamingSparkline: with an expected count, the plot equals
+ * Sparkline() of the same values, and an empty input or a count
+ * mismatch is an error rather than a wrong plot
+ *
+ *   make test
+ */
+
+/// System/STL
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+/// Local files
+#include "Sparkline.h"
+
+
+
+/// Number of failed checks
+int failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (not (condition)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" \
+                << #condition << ") failed" << std::endl; \
+      ++failures; \
+    } \
+  } while (0)
+
+
+/**
+ * Push the first "pushed" values of "data" into a stream that expects
+ * "expected" of them; TRUE iff render() threw
+ */
+bool RenderThrows( const std::vector<float>& data,
+                   size_t pushed,
+                   size_t expected,
+                   const Sparkline::Configuration<float>& config )
+{
+  Sparkline::StreamingSparkline<float> streaming(config, expected);
+  for (size_t i = 0; i < pushed; ++i)
+    streaming.push(data[i]);
+  try {
+    streaming.render();
+  } catch (const std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+
+int main()
+{
+  std::vector<float> data(1000);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = std::sin(i*0.05f)*(1+i%7);
+
+  Sparkline::Configuration<float> config(3, 40);
+  config.setColor(false);
+
+  /// An exact count gives the plot of the default mode
+  Sparkline::StreamingSparkline<float> streaming(config, data.size());
+  for (size_t i = 0; i < data.size(); ++i)
+    streaming.push(data[i]);
+  CHECK(streaming.render() == Sparkline::Sparkline(data, config));
+
+  /// No values, with and without an expected count
+  CHECK(RenderThrows(data, 0, 0, config));
+  CHECK(RenderThrows(data, 0, 10, config));
+
+  /// Fewer and more values than expected
+  CHECK(RenderThrows(data, 3, 10, config));
+  CHECK(RenderThrows(data, 6, 3, config));
+  CHECK(not RenderThrows(data, 10, 10, config));
+  CHECK(not RenderThrows(data, 6, 0, config));
+
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "StreamingSparklineTest: all checks passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/**
+ * Tests of ThreadPool: loops run every task once, and an exception
+ * thrown by a task (on a worker or on the calling thread) reaches the
+ * caller of run() without taking the pool down
+ *
+ *   make test
+ */
+
+/// System/STL
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+/// Local files
+#include "ThreadPool.h"
+
+
+
+/// Number of failed checks
+int failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (not (condition)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" \
+                << #condition << ") failed" << std::endl; \
+      ++failures; \
+    } \
+  } while (0)
+
+
+/**
+ * Run a loop whose task "thrower" throws; TRUE iff run() rethrew it
+ */
+bool Throws( ThreadPool::ThreadPool& pool,
+             size_t thrower )
+{
+  try {
+    pool.run(1000, 4, [&](size_t i) {
+      if (i == thrower)
+        throw std::logic_error("task failed");
+      std::this_thread::yield();
+    });
+  } catch (const std::logic_error&) {
+    return true;
+  }
+  return false;
+}
+
+
+int main()
+{
+  ThreadPool::ThreadPool pool(3);
+  CHECK(pool.size() == 3);
+
+  /// Every task runs exactly once
+  std::vector<std::atomic<int> > runs(1000);
+  for (size_t i = 0; i < runs.size(); ++i)
+    runs[i] = 0;
+  pool.run(runs.size(), 4, [&](size_t i) { ++runs[i]; });
+  bool once = true;
+  for (size_t i = 0; i < runs.size(); ++i)
+    once = once and runs[i] == 1;
+  CHECK(once);
+
+  /// Exceptions, early (most likely on the calling thread) and late
+  /// (most likely on a worker)
+  CHECK(Throws(pool, 0));
+  CHECK(Throws(pool, 500));
+  CHECK(Throws(pool, 999));
+
+  /// The pool is still usable, also for nested loops
+  std::atomic<size_t> sum(0);
+  pool.run(100, 4, [&](size_t i) {
+    pool.run(10, 4, [&](size_t j) { sum += i*10+j; });
+  });
+  CHECK(sum == 999*1000/2);
+
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "ThreadPoolTest: all checks passed" << std::endl;
+  return EXIT_SUCCESS;
+}